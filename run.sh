@@ -1,4 +1,4 @@
 #!/bin/bash
 
 DIR=$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )
-${DIR}/build/release/driver
+${DIR}/build/release/driver "$@"
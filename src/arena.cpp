@@ -0,0 +1,112 @@
+#include "arena.h"
+
+#include <sys/mman.h>
+
+#include <iostream>
+#include <new>
+
+using namespace::std;
+
+Arena *Arena::current_arena_ = nullptr;
+
+// The destructor
+Arena::~Arena() {
+    for (auto &block : blocks_)
+        munmap(block.data, block.size);
+}
+
+// Map anonymous memory aligned to huge pages
+char *mapHugePages(size_t size) {
+    // Map an extra huge page and trim the unaligned head and the tail
+    size_t length = size + ARENA_BLOCK_ALIGNMENT;
+    char *addr = static_cast<char *>(mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (addr == MAP_FAILED)
+        throw bad_alloc();
+    uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+    uintptr_t aligned = (begin + ARENA_BLOCK_ALIGNMENT - 1) & ~(ARENA_BLOCK_ALIGNMENT - 1);
+    if (aligned > begin)
+        munmap(addr, aligned - begin);
+    if (aligned + size < begin + length)
+        munmap(reinterpret_cast<char *>(aligned + size), begin + length - aligned - size);
+    char *data = reinterpret_cast<char *>(aligned);
+    madvise(data, size, MADV_HUGEPAGE);
+    return data;
+}
+
+// Map a new block of at least size bytes
+void Arena::addBlock(size_t size) {
+    size = (max<size_t>(size, ARENA_BLOCK_SIZE) + ARENA_BLOCK_ALIGNMENT - 1)
+        & ~(ARENA_BLOCK_ALIGNMENT - 1);
+    blocks_.push_back(Block{mapHugePages(size), size});
+    mapped_ += size;
+}
+
+// Draw bytes
+void *Arena::allocate(size_t bytes) {
+    bytes = (max<size_t>(bytes, 1) + ARENA_ALIGNMENT - 1) & ~size_t(ARENA_ALIGNMENT - 1);
+    lock_guard<mutex> lock(mutex_);
+    ++allocations_;
+    drawn_ += bytes;
+    // Skip to the next block large enough (the rest of the skipped blocks
+    // stays unused until the arena is rewound)
+    while (current_ < blocks_.size() && offset_ + bytes > blocks_[current_].size) {
+        ++current_;
+        offset_ = 0;
+    }
+    if (current_ == blocks_.size())
+        addBlock(bytes);
+    void *result = blocks_[current_].data + offset_;
+    offset_ += bytes;
+    return result;
+}
+
+// Release the allocations made since a position
+void Arena::rewind(size_t block, size_t offset) {
+    if (block == 0 && offset == 0) {
+        reset();
+        return;
+    }
+    lock_guard<mutex> lock(mutex_);
+    current_ = block;
+    offset_ = offset;
+}
+
+// Release all allocations at once
+void Arena::reset() {
+    lock_guard<mutex> lock(mutex_);
+    current_ = 0;
+    offset_ = 0;
+    ++resets_;
+    while (mapped_ > ARENA_RETAIN_BYTES && !blocks_.empty()) {
+        munmap(blocks_.back().data, blocks_.back().size);
+        mapped_ -= blocks_.back().size;
+        blocks_.pop_back();
+    }
+}
+
+// Print statistics
+void Arena::report(ostream &out) {
+    lock_guard<mutex> lock(mutex_);
+    out << "Arena: " << allocations_ << " allocations, "
+        << drawn_ / (1024.0 * 1024.0) << " MB drawn, " << resets_ << " resets, "
+        << blocks_.size() << " blocks, " << mapped_ / (1024.0 * 1024.0) << " MB mapped"
+        << endl;
+}
+
+// The constructor
+ArenaScope::ArenaScope(Arena *arena) : arena_(arena), previous_(Arena::current_arena_) {
+    Arena::current_arena_ = arena;
+    if (arena) {
+        lock_guard<mutex> lock(arena->mutex_);
+        block_ = arena->current_;
+        offset_ = arena->offset_;
+    }
+}
+
+// The destructor
+ArenaScope::~ArenaScope() {
+    Arena::current_arena_ = previous_;
+    if (arena_)
+        arena_->rewind(block_, offset_);
+}
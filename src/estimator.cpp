@@ -0,0 +1,238 @@
+#include "estimator.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <omp.h>
+
+#include "scan_cache.h"
+
+using namespace::std;
+
+namespace {
+
+/// The predicates among a set of bindings connect all of them
+bool connected(const QueryInfo &query, const set<unsigned> &bindings) {
+    set<unsigned> reached{*bindings.begin()};
+    for (bool grown = true; grown;) {
+        grown = false;
+        for (auto &p_info : query.predicates()) {
+            if (!bindings.count(p_info.left.binding) || !bindings.count(p_info.right.binding))
+                continue;
+            if (reached.count(p_info.left.binding) != reached.count(p_info.right.binding)) {
+                reached.insert(p_info.left.binding);
+                reached.insert(p_info.right.binding);
+                grown = true;
+            }
+        }
+    }
+    return reached.size() == bindings.size();
+}
+
+} // namespace
+
+// Fraction of the tuples of a relation whose column lies in a range
+double CardinalityEstimator::selectivity(RelationId rel_id, const ColumnRange &range) const {
+    auto &rel_stats = statistics_[rel_id];
+    if (rel_stats.size == 0)
+        return 0.0;
+    auto &stats = rel_stats.columns[range.col_id];
+    if (range.high < stats.min || range.low > stats.max)
+        return 0.0;
+    if (range.low == range.high)
+        return stats.values.mayContain(range.low) ? 1.0 / stats.distinct : 0.0;
+
+    uint64_t low = max(range.low, stats.min);
+    uint64_t high = min(range.high, stats.max);
+    double count = stats.histogram.get_number_of_records_geq_leq(low, high);
+    // At least one value per distinct value in the range
+    double min_count = 1.0 * rel_stats.size / stats.distinct;
+    return min(1.0, max(count, min_count) / rel_stats.size);
+}
+
+// Start planning a query
+void CardinalityEstimator::startQuery(const QueryInfo &query) {
+    query_ = &query;
+    deadline_ = omp_get_wtime() + SAMPLING_BUDGET_PER_QUERY;
+    memo_.clear();
+    statistics_memo_.clear();
+}
+
+// Estimated number of tuples of a binding passing its filters (statistics only)
+double CardinalityEstimator::statisticsScan(const QueryInfo &query, unsigned binding) const {
+    RelationId rel_id = query.relation_ids()[binding];
+    FilterKey key(rel_id, query.filtersOf(binding));
+    if (key.unsatisfiable())
+        return 0.0;
+    double size = statistics_[rel_id].size;
+    for (auto &range : key.ranges())
+        size *= selectivity(rel_id, range);
+    return size;
+}
+
+// The statistics prove that the query has no result
+bool CardinalityEstimator::provesEmpty(const QueryInfo &query) const {
+    if (!ready())
+        return false;
+    auto &rel_ids = query.relation_ids();
+    for (unsigned binding = 0; binding < rel_ids.size(); ++binding) {
+        auto &rel_stats = statistics_[rel_ids[binding]];
+        FilterKey key(rel_ids[binding], query.filtersOf(binding));
+        if (rel_stats.size == 0 || key.unsatisfiable())
+            return true;
+        // A range outside [min, max] or a constant missing in the Bloom filter
+        for (auto &range : key.ranges()) {
+            auto &stats = rel_stats.columns[range.col_id];
+            if (range.high < stats.min || range.low > stats.max)
+                return true;
+            if (range.low == range.high && !stats.values.mayContain(range.low))
+                return true;
+        }
+    }
+    // Join columns with disjoint value ranges
+    for (auto &p_info : query.predicates()) {
+        auto &left = statistics_[rel_ids[p_info.left.binding]].columns[p_info.left.col_id];
+        auto &right = statistics_[rel_ids[p_info.right.binding]].columns[p_info.right.col_id];
+        if (left.max < right.min || right.max < left.min)
+            return true;
+    }
+    return false;
+}
+
+// Estimated number of distinct values of a column passing the filters
+double CardinalityEstimator::estimateDistinct(const QueryInfo &query,
+                                              const SelectInfo &column) const {
+    RelationId rel_id = query.relation_ids()[column.binding];
+    double distinct = statistics_[rel_id].columns[column.col_id].distinct;
+    FilterKey key(rel_id, query.filtersOf(column.binding));
+    for (auto &range : key.ranges()) {
+        if (range.col_id != column.col_id)
+            continue;
+        // Filters on the column itself remove values, filters on other
+        // columns only tuples
+        distinct = range.low == range.high ? 1.0 : distinct * selectivity(rel_id, range);
+    }
+    return max(1.0, min(distinct, statisticsScan(query, column.binding)));
+}
+
+// All values of a column are contained in a key column
+bool CardinalityEstimator::references(const QueryInfo &query, const SelectInfo &column,
+                                      const SelectInfo &key) const {
+    auto &rel_ids = query.relation_ids();
+    auto &references = statistics_[rel_ids[column.binding]].columns[column.col_id].references;
+    return find(references.begin(), references.end(),
+                make_pair(rel_ids[key.binding], key.col_id)) != references.end();
+}
+
+// All predicates joining a binding with the others of a set are on keys of it
+bool CardinalityEstimator::joinedOnKey(const QueryInfo &query, const set<unsigned> &bindings,
+                                       unsigned binding, bool &referenced) const {
+    bool joined = false;
+    referenced = true;
+    for (auto &p_info : query.predicates()) {
+        const SelectInfo *mine, *other;
+        if (p_info.left.binding == binding && p_info.right.binding != binding) {
+            mine = &p_info.left;
+            other = &p_info.right;
+        } else if (p_info.right.binding == binding && p_info.left.binding != binding) {
+            mine = &p_info.right;
+            other = &p_info.left;
+        } else {
+            continue;
+        }
+        if (!bindings.count(other->binding))
+            continue;
+        if (!statistics_[query.relation_ids()[binding]].columns[mine->col_id].unique)
+            return false;
+        referenced &= references(query, *other, *mine);
+        joined = true;
+    }
+    return joined;
+}
+
+// Estimated result size of joining a set of bindings (statistics only)
+double CardinalityEstimator::statisticsEstimate(const QueryInfo &query,
+                                                const set<unsigned> &bindings) const {
+    // The estimates of subsets are kept for the whole query being planned,
+    // for other queries for the call
+    if (&query == query_)
+        return statisticsEstimate(query, bindings, statistics_memo_);
+    map<set<unsigned>, double> memo;
+    return statisticsEstimate(query, bindings, memo);
+}
+
+// Estimate from statistics, memoizing the estimates of binding sets
+double CardinalityEstimator::statisticsEstimate(const QueryInfo &query,
+                                                const set<unsigned> &bindings,
+                                                map<set<unsigned>, double> &memo) const {
+    auto iter = memo.find(bindings);
+    if (iter != memo.end())
+        return iter->second;
+
+    double size = 1.0;
+    for (auto binding : bindings)
+        size *= statisticsScan(query, binding);
+    for (auto &p_info : query.predicates()) {
+        if (!bindings.count(p_info.left.binding) || !bindings.count(p_info.right.binding))
+            continue;
+        // Every value of the side with fewer distinct values finds its
+        // partners on the other side
+        size /= max(estimateDistinct(query, p_info.left),
+                    estimateDistinct(query, p_info.right));
+    }
+
+    // Joining a binding on a key never increases the size of the others. If
+    // the binding is unfiltered and only joined with foreign keys referencing
+    // it, every tuple of the others finds its partner
+    if (bindings.size() > 1) {
+        for (auto binding : bindings) {
+            bool referenced;
+            if (!joinedOnKey(query, bindings, binding, referenced))
+                continue;
+            auto others = bindings;
+            others.erase(binding);
+            if (!connected(query, others))
+                continue;
+            double others_size = statisticsEstimate(query, others, memo);
+            if (referenced && query.filtersOf(binding).empty()) {
+                size = others_size;
+                break;
+            }
+            size = min(size, others_size);
+        }
+    }
+    memo.emplace(bindings, size);
+    return size;
+}
+
+// Estimated number of tuples of a binding passing its filters
+double CardinalityEstimator::estimateScan(const QueryInfo &query, unsigned binding) const {
+    return estimate(query, {binding});
+}
+
+// Estimated result size of joining a set of bindings
+double CardinalityEstimator::estimate(const QueryInfo &query,
+                                      const set<unsigned> &bindings) const {
+    // The same sub-plan has been executed before
+    double actual;
+    if (feedback_ && feedback_->lookup(CardinalityFeedback::signature(query, bindings), actual))
+        return actual;
+    return estimateWithoutFeedback(query, bindings);
+}
+
+// The estimate before the correction by feedback of executed sub-plans
+double CardinalityEstimator::estimateWithoutFeedback(const QueryInfo &query,
+                                                     const set<unsigned> &bindings) const {
+    // Samples are only used while planning the query started last
+    if (!sampler_ || !sampler_->ready() || &query != query_)
+        return statisticsEstimate(query, bindings);
+
+    auto iter = memo_.find(bindings);
+    if (iter != memo_.end())
+        return iter->second;
+    double size = numeric_limits<double>::infinity();
+    if (omp_get_wtime() > deadline_ || !sampler_->estimate(query, bindings, deadline_, size))
+        size = min(size, statisticsEstimate(query, bindings));
+    memo_.emplace(bindings, size);
+    return size;
+}
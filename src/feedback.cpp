@@ -0,0 +1,87 @@
+#include "feedback.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "scan_cache.h"
+
+using namespace::std;
+
+// The signature of the sub-plan joining a set of bindings of a query
+string CardinalityFeedback::signature(const QueryInfo &query, const set<unsigned> &bindings) {
+    map<unsigned, string> inputs;
+    vector<string> parts;
+    for (auto binding : bindings) {
+        inputs[binding] = FilterKey(query.relation_ids()[binding], query.filtersOf(binding)).str();
+        parts.push_back(inputs[binding]);
+    }
+    sort(parts.begin(), parts.end());
+
+    vector<string> edges;
+    for (auto &p : query.predicates()) {
+        if (!bindings.count(p.left.binding) || !bindings.count(p.right.binding))
+            continue;
+        auto left = inputs[p.left.binding] + "." + to_string(p.left.col_id);
+        auto right = inputs[p.right.binding] + "." + to_string(p.right.col_id);
+        if (right < left)
+            swap(left, right);
+        edges.push_back(left + "=" + right);
+    }
+    sort(edges.begin(), edges.end());
+
+    string out;
+    for (auto &part : parts)
+        out += part + ";";
+    out += "#";
+    for (auto &edge : edges)
+        out += edge + ";";
+    return out;
+}
+
+// Record the estimated and actual size of a sub-plan
+void CardinalityFeedback::record(const string &signature, double estimated, double actual) {
+    lock_guard<mutex> lock(mutex_);
+    ++records_;
+    double q_error = max(1.0, estimated) / max(1.0, actual);
+    q_errors_ += max(q_error, 1.0 / q_error);
+    auto iter = index_.find(signature);
+    if (iter != index_.end()) {
+        iter->second->estimated = estimated;
+        iter->second->actual = actual;
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        return;
+    }
+    lru_.push_front(Entry{signature, estimated, actual});
+    index_.emplace(signature, lru_.begin());
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().signature);
+        lru_.pop_back();
+    }
+}
+
+// The actual size of a sub-plan
+bool CardinalityFeedback::lookup(const string &signature, double &actual) const {
+    lock_guard<mutex> lock(mutex_);
+    auto iter = index_.find(signature);
+    if (iter == index_.end())
+        return false;
+    actual = iter->second->actual;
+    ++corrections_;
+    return true;
+}
+
+// Drop all entries
+void CardinalityFeedback::clear() {
+    lock_guard<mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+}
+
+// Print statistics
+void CardinalityFeedback::report(ostream &out) const {
+    lock_guard<mutex> lock(mutex_);
+    out << "Cardinality feedback: " << records_ << " records (mean q-error "
+        << (records_ ? q_errors_ / records_ : 1.0) << "), " << corrections_
+        << " corrected estimates, " << lru_.size() << " entries" << endl;
+}
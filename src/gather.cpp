@@ -0,0 +1,40 @@
+#include "gather.h"
+
+#include <algorithm>
+
+using namespace::std;
+
+// The constructor
+template <typename RowId>
+Gather<RowId>::Gather(const RowId *ids, uint64_t count, uint64_t column_size)
+    : ids_(ids), count_(count), strategy_(GatherStrategy::Direct) {
+    if (column_size * sizeof(uint64_t) <= GATHER_CACHED_COLUMN_BYTES
+        || is_sorted(ids, ids + count))
+        return;
+    strategy_ = GatherStrategy::Prefetch;
+}
+
+// Gather the values of a column into out
+template <typename RowId>
+void Gather<RowId>::gather(const uint64_t *column, uint64_t *out) const {
+    switch (strategy_) {
+        case GatherStrategy::Direct:
+            for (uint64_t i = 0; i < count_; ++i)
+                out[i] = column[ids_[i]];
+            break;
+        case GatherStrategy::Prefetch: {
+            uint64_t ahead = count_ > GATHER_PREFETCH_DISTANCE ? count_ - GATHER_PREFETCH_DISTANCE : 0;
+            uint64_t i = 0;
+            for (; i < ahead; ++i) {
+                __builtin_prefetch(&column[ids_[i + GATHER_PREFETCH_DISTANCE]]);
+                out[i] = column[ids_[i]];
+            }
+            for (; i < count_; ++i)
+                out[i] = column[ids_[i]];
+            break;
+        }
+    }
+}
+
+template class Gather<uint32_t>;
+template class Gather<uint64_t>;
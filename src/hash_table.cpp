@@ -0,0 +1,141 @@
+#include "hash_table.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <omp.h>
+
+#define RESERVE_FACTOR 2
+
+using namespace::std;
+
+// Build the table on a key column
+void JoinHashTable::build(const uint64_t *keys, uint64_t size, uint64_t num_partitions,
+                          bool unique) {
+    num_partitions_ = num_partitions;
+    size_ = size;
+    unique_ = unique;
+    maps_.clear();
+    slots_.clear();
+    heavy_ids_.clear();
+    heavy_offsets_.clear();
+    if (unique) {
+        slots_.resize(num_partitions);
+        shifts_.resize(num_partitions);
+    } else {
+        maps_.resize(num_partitions);
+    }
+
+    // Detect the heavy hitters on a sample of the build tuples
+    vector<uint64_t> heavy_keys;
+    if (!unique && size >= HEAVY_HITTER_SAMPLE_SIZE) {
+        mt19937_64 rng(42);
+        vector<uint64_t> sample(HEAVY_HITTER_SAMPLE_SIZE);
+        for (auto &key : sample)
+            key = keys[rng() % size];
+        sort(sample.begin(), sample.end());
+        uint64_t min_count = max<uint64_t>(2, ceil(HEAVY_HITTER_SAMPLE_SIZE * HEAVY_HITTER_MIN_SHARE));
+        for (size_t i = 0, j; i < sample.size(); i = j) {
+            for (j = i + 1; j < sample.size() && sample[j] == sample[i]; ++j);
+            if (j - i >= min_count)
+                heavy_keys.push_back(sample[i]);
+        }
+    }
+
+    // Collect the tuple ids of every heavy hitter (in ascending order)
+    vector<uint8_t> heavy_tuple;
+    if (!heavy_keys.empty()) {
+        heavy_tuple.resize(size);
+        vector<vector<uint64_t>> ids(heavy_keys.size());
+        for (uint64_t i = 0; i < size; ++i) {
+            auto iter = lower_bound(heavy_keys.begin(), heavy_keys.end(), keys[i]);
+            if (iter != heavy_keys.end() && *iter == keys[i]) {
+                ids[iter - heavy_keys.begin()].push_back(i);
+                heavy_tuple[i] = 1;
+            }
+        }
+        heavy_offsets_.push_back(0);
+        for (auto &run : ids) {
+            heavy_ids_.insert(heavy_ids_.end(), run.begin(), run.end());
+            heavy_offsets_.push_back(heavy_ids_.size());
+        }
+    }
+
+    uint64_t size_per_partition = (size / num_partitions) + (size % num_partitions != 0);
+    ArenaVector<uint64_t> rem(size);
+    ArenaVector<uint64_t> quot(size);
+    // The team may be smaller than requested (in nested parallel regions):
+    // every slice and partition is a loop iteration of its own
+    #pragma omp parallel for num_threads(num_partitions)
+    for (uint64_t tid = 0; tid < num_partitions; ++tid) {
+        uint64_t start = size_per_partition * tid;
+        uint64_t end = start + size_per_partition;
+        if (end > size) end = size;
+        for (uint64_t i = start; i < end; ++i) {
+            rem[i] = keys[i] % num_partitions;
+            quot[i] = keys[i] / num_partitions;
+        }
+    }
+
+    #pragma omp parallel for num_threads(num_partitions)
+    for (uint64_t tid = 0; tid < num_partitions; ++tid) {
+        if (unique) {
+            // At most half of the slots are used
+            uint64_t count = 0;
+            for (uint64_t i = 0; i < size; ++i)
+                count += rem[i] == tid;
+            unsigned bits = 1;
+            while ((1ull << bits) < count * RESERVE_FACTOR)
+                ++bits;
+            shifts_[tid] = 64 - bits;
+            auto &slots = slots_[tid];
+            slots.assign(1ull << bits, Slot{0, kEmpty});
+            uint64_t mask = slots.size() - 1;
+            for (uint64_t i = 0; i < size; ++i) {
+                if (rem[i] != tid)
+                    continue;
+                uint64_t pos = slotOf(quot[i], tid);
+                while (slots[pos].id != kEmpty)
+                    pos = (pos + 1) & mask;
+                slots[pos] = Slot{quot[i], i};
+            }
+        } else {
+            maps_[tid].reserve(size_per_partition * RESERVE_FACTOR);
+            if (heavy_keys.empty()) {
+                for (uint64_t i = 0; i < size; ++i) {
+                    if (rem[i] == tid) {
+                        maps_[tid].emplace(quot[i], i);
+                    }
+                }
+            } else {
+                for (uint64_t i = 0; i < size; ++i) {
+                    if (rem[i] == tid && !heavy_tuple[i]) {
+                        maps_[tid].emplace(quot[i], i);
+                    }
+                }
+                // A single entry per heavy hitter refers to its ids
+                for (uint64_t h = 0; h < heavy_keys.size(); ++h) {
+                    if (heavy_keys[h] % num_partitions == tid)
+                        maps_[tid].emplace(heavy_keys[h] / num_partitions, kHeavy | h);
+                }
+            }
+        }
+    }
+}
+
+// The (approximate) memory held by the table
+size_t JoinHashTable::memory() const {
+    size_t bytes = 0;
+    for (auto &slots : slots_)
+        bytes += slots.size() * sizeof(Slot);
+    for (auto &map : maps_) {
+        // One node (entry + next pointer + cached hash) per tuple and one
+        // pointer per bucket
+        bytes += map.size() * (sizeof(HT::value_type) + 2 * sizeof(void *))
+            + map.bucket_count() * sizeof(void *);
+    }
+    bytes += (heavy_ids_.size() + heavy_offsets_.size()) * sizeof(uint64_t);
+    return bytes;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+/// Bytes of a block of the arena (larger allocations get a block of their own)
+#define ARENA_BLOCK_SIZE (64ull << 20)
+/// Alignment and size granularity of the blocks (the huge-page size)
+#define ARENA_BLOCK_ALIGNMENT (2ull << 20)
+/// Alignment of every allocation (a cache line)
+#define ARENA_ALIGNMENT 64
+/// Blocks beyond this budget are unmapped when the arena is reset (bytes)
+#define ARENA_RETAIN_BYTES (4ull << 30)
+
+/// Map size bytes (a multiple of ARENA_BLOCK_ALIGNMENT) of anonymous memory
+/// aligned to and advised for huge pages (release them with munmap)
+char *mapHugePages(size_t size);
+
+/// Bump allocator for the intermediate buffers of a query. The blocks are
+/// huge-page aligned and stay mapped (and faulted in) across resets, so
+/// the next query reuses them without page faults. Nothing is freed before
+/// the arena is reset.
+class Arena {
+    private:
+        struct Block {
+            /// The memory
+            char *data;
+            /// The size (bytes)
+            size_t size;
+        };
+
+        /// The blocks (allocations are drawn from blocks_[current_] on)
+        std::vector<Block> blocks_;
+        /// The block allocations are drawn from
+        size_t current_ = 0;
+        /// The bytes drawn from the current block
+        size_t offset_ = 0;
+        /// Protects everything above (operators allocate concurrently)
+        std::mutex mutex_;
+
+        /// Statistics
+        uint64_t allocations_ = 0, resets_ = 0;
+        size_t drawn_ = 0, mapped_ = 0;
+
+        /// The arena of the running query (may be null)
+        static Arena *current_arena_;
+
+        /// Map a new block of at least size bytes
+        void addBlock(size_t size);
+        /// Release the allocations made since the position (block, offset)
+        void rewind(size_t block, size_t offset);
+
+        friend class ArenaScope;
+
+    public:
+        /// The constructor
+        Arena() = default;
+        /// The destructor (unmaps the blocks)
+        ~Arena();
+        /// Delete copy constructor
+        Arena(const Arena &other) = delete;
+
+        /// Draw bytes (aligned to ARENA_ALIGNMENT)
+        void *allocate(size_t bytes);
+        /// Release all allocations at once (the blocks stay mapped up to
+        /// ARENA_RETAIN_BYTES)
+        void reset();
+
+        /// The memory mapped by the arena (bytes)
+        size_t mapped() const { return mapped_; }
+        /// The arena of the running query (null if none)
+        static Arena *current() { return current_arena_; }
+
+        /// Print statistics
+        void report(std::ostream &out);
+};
+
+/// Makes an arena the current one while the scope is alive and releases
+/// the allocations made within the scope at exit (scopes nest like a stack:
+/// e.g. a batch and its queries)
+class ArenaScope {
+    private:
+        /// The arena
+        Arena *arena_;
+        /// The arena current before the scope
+        Arena *previous_;
+        /// The position of the arena when the scope was opened
+        size_t block_ = 0, offset_ = 0;
+
+    public:
+        /// The constructor (a null arena leaves allocations on the heap)
+        explicit ArenaScope(Arena *arena);
+        /// The destructor
+        ~ArenaScope();
+        /// Delete copy constructor
+        ArenaScope(const ArenaScope &other) = delete;
+};
+
+/// Allocator drawing from the arena that is current when it is constructed
+/// (from the heap if there is none). Elements are default-initialized, so
+/// resizing a buffer of integers does not zero it.
+template <typename T>
+class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        /// The arena (null: the heap)
+        Arena *arena_;
+
+        /// The constructor
+        ArenaAllocator() : arena_(Arena::current()) {}
+        /// The converting constructor
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena_) {}
+
+        /// Allocate n elements
+        T *allocate(size_t n) {
+            if (arena_)
+                return static_cast<T *>(arena_->allocate(n * sizeof(T)));
+            return std::allocator<T>().allocate(n);
+        }
+        /// Deallocate (arena memory is released by the reset)
+        void deallocate(T *p, size_t n) {
+            if (!arena_)
+                std::allocator<T>().deallocate(p, n);
+        }
+        /// Default-initialize an element
+        template <typename U>
+        void construct(U *p) { ::new (static_cast<void *>(p)) U; }
+        /// Construct an element from arguments
+        template <typename U, typename... Args>
+        void construct(U *p, Args &&...args) {
+            ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena_; }
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena_; }
+};
+
+/// A vector drawing from the current arena
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
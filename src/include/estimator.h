@@ -0,0 +1,82 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "feedback.h"
+#include "parser.h"
+#include "sampling.h"
+#include "statistics.h"
+
+/// Time spent on sampling-based estimates per query (seconds)
+#define SAMPLING_BUDGET_PER_QUERY 0.002
+
+/// Estimates the result sizes of (sub-)plans. Uses samples when available
+/// and the sampling budget of the query is not exhausted, otherwise column
+/// statistics, assuming uniform values within histogram intervals and
+/// independent predicates
+class CardinalityEstimator {
+    private:
+        /// The statistics of all relations (indexed by relation id)
+        const std::vector<RelationStatistics> &statistics_;
+        /// The samples (nullptr: estimate from statistics only)
+        const SamplingEstimator *sampler_ = nullptr;
+        /// The sizes of executed sub-plans (may be null)
+        const CardinalityFeedback *feedback_ = nullptr;
+
+        /// The query being planned and the end of its sampling budget
+        const QueryInfo *query_ = nullptr;
+        double deadline_ = 0.0;
+        /// The estimates of the query being planned (by binding set)
+        mutable std::map<std::set<unsigned>, double> memo_;
+        /// The statistics-only estimates of the query being planned (by
+        /// binding set)
+        mutable std::map<std::set<unsigned>, double> statistics_memo_;
+
+    private:
+        /// All values of a column are contained in a key column (foreign key)
+        bool references(const QueryInfo &query, const SelectInfo &column,
+                        const SelectInfo &key) const;
+        /// All predicates joining a binding with the others of a set are on
+        /// keys of the binding (referenced: all by foreign keys)
+        bool joinedOnKey(const QueryInfo &query, const std::set<unsigned> &bindings,
+                         unsigned binding, bool &referenced) const;
+        /// Estimates from statistics only
+        double statisticsScan(const QueryInfo &query, unsigned binding) const;
+        double statisticsEstimate(const QueryInfo &query, const std::set<unsigned> &bindings) const;
+        /// Estimate from statistics, memoizing the estimates of binding sets
+        double statisticsEstimate(const QueryInfo &query, const std::set<unsigned> &bindings,
+                                  std::map<std::set<unsigned>, double> &memo) const;
+
+    public:
+        /// The constructor
+        explicit CardinalityEstimator(const std::vector<RelationStatistics> &statistics)
+            : statistics_(statistics) {};
+
+        /// Statistics are available
+        bool ready() const { return !statistics_.empty(); }
+        /// Use samples for estimates
+        void setSampler(const SamplingEstimator *sampler) { sampler_ = sampler; }
+        /// Correct estimates of executed sub-plans
+        void setFeedback(const CardinalityFeedback *feedback) { feedback_ = feedback; }
+        /// Start planning a query: samples are used for its estimates until
+        /// its sampling budget is exhausted
+        void startQuery(const QueryInfo &query);
+
+        /// Fraction of the tuples of a relation whose column lies in a range
+        double selectivity(RelationId rel_id, const ColumnRange &range) const;
+        /// The statistics prove that the query has no result (e.g. a filter
+        /// constant outside [min, max] of its column or not in its Bloom filter)
+        bool provesEmpty(const QueryInfo &query) const;
+        /// Estimated number of tuples of a binding passing its filters
+        double estimateScan(const QueryInfo &query, unsigned binding) const;
+        /// Estimated number of distinct values of a column passing the filters
+        double estimateDistinct(const QueryInfo &query, const SelectInfo &column) const;
+        /// Estimated result size of joining a set of bindings (with all
+        /// predicates among them applied)
+        double estimate(const QueryInfo &query, const std::set<unsigned> &bindings) const;
+        /// The estimate before the correction by feedback of executed sub-plans
+        double estimateWithoutFeedback(const QueryInfo &query,
+                                       const std::set<unsigned> &bindings) const;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "parser.h"
+
+/// Default number of sub-plans remembered by the cardinality feedback store
+#define FEEDBACK_CAPACITY (1u << 16)
+
+/// Remembers the estimated and actual sizes of executed sub-plans, so that
+/// later estimates of the same sub-plan (relations, filters and join edges)
+/// are replaced by the actual size. Bounded: the least recently used
+/// sub-plans are dropped
+class CardinalityFeedback {
+    private:
+        struct Entry {
+            /// The sub-plan signature
+            std::string signature;
+            /// The estimated size (without feedback)
+            double estimated;
+            /// The actual size
+            double actual;
+        };
+
+        /// The maximal number of entries
+        size_t capacity_;
+        /// The entries (most recently used first)
+        std::list<Entry> lru_;
+        /// Mapping from signature to entry
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        /// Protects everything above
+        mutable std::mutex mutex_;
+
+        /// Statistics
+        mutable uint64_t corrections_ = 0;
+        uint64_t records_ = 0;
+        /// The sum of the q-errors of the recorded estimates
+        double q_errors_ = 0.0;
+
+    public:
+        /// The constructor
+        explicit CardinalityFeedback(size_t capacity = FEEDBACK_CAPACITY)
+            : capacity_(capacity) {};
+
+        /// The signature of the sub-plan joining a set of bindings of a query;
+        /// independent of binding numbers and predicate order
+        static std::string signature(const QueryInfo &query, const std::set<unsigned> &bindings);
+
+        /// Record the estimated (without feedback) and actual size of a sub-plan
+        void record(const std::string &signature, double estimated, double actual);
+        /// The actual size of a sub-plan. Returns false if the sub-plan is unknown
+        bool lookup(const std::string &signature, double &actual) const;
+        /// Drop all entries
+        void clear();
+
+        /// The number of entries
+        size_t size() const { return lru_.size(); }
+        /// Print statistics
+        void report(std::ostream &out) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+/// Columns up to this size (bytes) are gathered directly: they stay cached
+#define GATHER_CACHED_COLUMN_BYTES (1ull << 20)
+/// Ids ahead of the current one whose values the prefetching gather requests
+#define GATHER_PREFETCH_DISTANCE 16
+
+/// How the values of a list of row ids are gathered from a column
+enum class GatherStrategy {
+    /// In list order (sorted lists and cached columns)
+    Direct,
+    /// In list order, prefetching the values of later ids
+    Prefetch
+};
+
+/// Gathers the values of columns at a list of row ids: out[i] = column[ids[i]].
+/// The strategy is chosen once from the ids and the column size and shared by
+/// all gathered columns. RowId is uint32_t or uint64_t (see dispatchRowId).
+template <typename RowId>
+class Gather {
+    private:
+        /// The row ids
+        const RowId *ids_;
+        /// The number of row ids
+        uint64_t count_;
+        /// The strategy
+        GatherStrategy strategy_;
+
+    public:
+        /// The constructor (the columns have column_size rows)
+        Gather(const RowId *ids, uint64_t count, uint64_t column_size);
+
+        /// The chosen strategy
+        GatherStrategy strategy() const { return strategy_; }
+
+        /// Gather the values of a column into out (count values)
+        void gather(const uint64_t *column, uint64_t *out) const;
+};
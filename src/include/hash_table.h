@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Build tuples sampled to detect heavy hitters (tables with duplicate keys)
+#define HEAVY_HITTER_SAMPLE_SIZE 1024
+/// Minimum share of the sampled build tuples holding a heavy-hitter key
+#define HEAVY_HITTER_MIN_SHARE 0.01
+
+/// Hash table of a join build side: maps key -> tuple id in the build input.
+/// Keys are partitioned by key % num_partitions so that partitions are built
+/// in parallel. If the keys are unique, every partition is a flat
+/// open-addressing table without duplicate chains. Otherwise, keys holding a
+/// large share of a sample of the build tuples (heavy hitters) keep their
+/// tuple ids in one array instead of a long duplicate chain in a single
+/// partition; their chain is a single entry referring to the array.
+class JoinHashTable {
+    public:
+        using HT = std::unordered_multimap<uint64_t, uint64_t>;
+        using Range = std::pair<HT::const_iterator, HT::const_iterator>;
+
+    private:
+        /// A slot of a unique-key partition
+        struct Slot {
+            /// The key / num_partitions_
+            uint64_t key;
+            /// The tuple id (kEmpty if the slot is free)
+            uint64_t id;
+        };
+        static constexpr uint64_t kEmpty = std::numeric_limits<uint64_t>::max();
+        /// Tag of a chain entry referring to the ids of a heavy hitter
+        static constexpr uint64_t kHeavy = 1ull << 63;
+
+        /// The number of partitions
+        uint64_t num_partitions_ = 1;
+        /// The partitions (storing key / num_partitions_)
+        std::vector<HT> maps_;
+        /// The keys are unique: the partitions are slots_ instead of maps_
+        bool unique_ = false;
+        /// The unique-key partitions (power-of-two sizes, linear probing)
+        std::vector<std::vector<Slot>> slots_;
+        /// The shift turning a hash into a slot of each unique-key partition
+        std::vector<unsigned> shifts_;
+        /// The number of build tuples
+        uint64_t size_ = 0;
+        /// The build tuple ids of the heavy hitters (one run per heavy hitter)
+        std::vector<uint64_t> heavy_ids_;
+        /// The start of the run of every heavy hitter in heavy_ids_ (and the end)
+        std::vector<uint64_t> heavy_offsets_;
+
+    private:
+        /// The first slot of a key in a unique-key partition
+        inline uint64_t slotOf(uint64_t key, uint64_t partition) const {
+            return (key * 0x9E3779B97F4A7C15ull) >> shifts_[partition];
+        }
+
+    public:
+        /// Build the table on a key column (unique: no key occurs twice)
+        void build(const uint64_t *keys, uint64_t size, uint64_t num_partitions,
+                   bool unique = false);
+
+        /// All build tuples matching a key (tables with duplicate keys). The
+        /// range of a heavy hitter is a single entry whose id is tagged (see
+        /// heavy and heavyIds)
+        inline Range equal_range(uint64_t key) const {
+            return maps_[key % num_partitions_].equal_range(key / num_partitions_);
+        }
+        /// The build tuple matching a key, or nullptr (unique-key tables)
+        inline const uint64_t *find(uint64_t key) const {
+            uint64_t partition = key % num_partitions_;
+            uint64_t quot = key / num_partitions_;
+            auto &slots = slots_[partition];
+            uint64_t mask = slots.size() - 1;
+            for (uint64_t pos = slotOf(quot, partition);; pos = (pos + 1) & mask) {
+                if (slots[pos].id == kEmpty)
+                    return nullptr;
+                if (slots[pos].key == quot)
+                    return &slots[pos].id;
+            }
+        }
+
+        /// Prefetch the first slot of a key (unique-key tables)
+        inline void prefetch(uint64_t key) const {
+            uint64_t partition = key % num_partitions_;
+            __builtin_prefetch(&slots_[partition][slotOf(key / num_partitions_, partition)]);
+        }
+
+        /// The id of an entry of equal_range refers to a heavy hitter
+        static inline bool heavy(uint64_t id) { return id & kHeavy; }
+        /// The heavy hitter referred to by a tagged id (0 .. num_heavy() - 1)
+        static inline uint64_t heavyIndex(uint64_t id) { return id & ~kHeavy; }
+        /// The build tuple ids of a heavy hitter
+        inline std::pair<const uint64_t *, const uint64_t *> heavyIds(uint64_t index) const {
+            return {heavy_ids_.data() + heavy_offsets_[index],
+                    heavy_ids_.data() + heavy_offsets_[index + 1]};
+        }
+        /// The number of heavy hitters
+        uint64_t num_heavy() const { return heavy_offsets_.empty() ? 0 : heavy_offsets_.size() - 1; }
+
+        /// Call f(build tuple id) for every build tuple matching a key
+        /// (tables with duplicate keys)
+        template <typename F>
+        inline void forEachMatch(uint64_t key, F &&f) const {
+            auto range = equal_range(key);
+            for (auto iter = range.first; iter != range.second; ++iter) {
+                if (heavy(iter->second)) {
+                    auto ids = heavyIds(heavyIndex(iter->second));
+                    for (auto id = ids.first; id != ids.second; ++id)
+                        f(*id);
+                } else {
+                    f(iter->second);
+                }
+            }
+        }
+
+        /// The keys are unique (use find instead of equal_range)
+        bool unique() const { return unique_; }
+
+        /// The number of partitions
+        uint64_t num_partitions() const { return num_partitions_; }
+        /// The number of build tuples
+        uint64_t size() const { return size_; }
+        /// The (approximate) memory held by the table (bytes)
+        size_t memory() const;
+};
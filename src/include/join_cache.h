@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "hash_table.h"
+#include "relation.h"
+
+/// Default memory budget of the join hash-table cache (bytes)
+#define JOIN_TABLE_CACHE_BUDGET (4ull << 30)
+/// Number of requests before a table on a filtered scan is cached
+#define JOIN_TABLE_CACHE_MIN_USES 2
+/// Maximal number of uncached keys whose requests are counted (the counts
+/// are dropped beyond)
+#define JOIN_TABLE_CACHE_MAX_COUNTED 4096
+
+/// A built hash table that is never modified again
+using SharedHashTable = std::shared_ptr<const JoinHashTable>;
+
+/// LRU cache of join hash tables built on base relation columns, shared across
+/// (possibly concurrently running) queries
+class JoinTableCache {
+    private:
+        struct Entry {
+            /// The cache key
+            std::string key;
+            /// The table
+            SharedHashTable table;
+            /// The memory held by the table
+            size_t bytes;
+        };
+
+        /// The memory budget (bytes)
+        size_t budget_;
+        /// The memory in use (bytes)
+        size_t used_ = 0;
+        /// The entries (most recently used first)
+        std::list<Entry> lru_;
+        /// Mapping from key to entry
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        /// The tables currently being built
+        std::unordered_map<std::string, std::shared_future<SharedHashTable>> building_;
+        /// The number of requests of tables that are not cached (yet)
+        std::unordered_map<std::string, unsigned> uses_;
+        /// Protects everything above
+        std::mutex mutex_;
+
+        /// Statistics
+        uint64_t hits_ = 0, misses_ = 0, evictions_ = 0;
+
+    private:
+        /// Evict least recently used entries until the budget is met
+        void evict();
+
+    public:
+        /// The constructor
+        explicit JoinTableCache(size_t budget = JOIN_TABLE_CACHE_BUDGET)
+            : budget_(budget) {};
+
+        /// The cache key of a table on a (filtered) base relation column
+        static std::string key(RelationId rel_id, unsigned col_id,
+                            const std::string &filter_fingerprint);
+
+        /// Get the table of a key or build it. If repeated_only is set, the
+        /// table is only cached once it was requested JOIN_TABLE_CACHE_MIN_USES
+        /// times. Concurrent requests of a table wait for a single build.
+        SharedHashTable get(const std::string &key, bool repeated_only,
+                            const std::function<SharedHashTable()> &build);
+        /// Drop all entries
+        void clear();
+
+        /// The number of hits and misses
+        uint64_t hits() const { return hits_; }
+        uint64_t misses() const { return misses_; }
+        /// The memory in use (bytes)
+        size_t used() const { return used_; }
+        /// The number of entries
+        size_t size() const { return lru_.size(); }
+        /// The number of uncached keys whose requests are counted
+        size_t counted() const { return uses_.size(); }
+
+        /// Print statistics
+        void report(std::ostream &out);
+};
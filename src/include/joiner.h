@@ -2,29 +2,210 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
 #include <set>
+#include <string>
+#include <unordered_map>
 
+#include "arena.h"
+#include "estimator.h"
+#include "feedback.h"
+#include "join_cache.h"
 #include "operators.h"
 #include "relation.h"
 #include "parser.h"
+#include "plan_cache.h"
+#include "sampling.h"
+#include "scan_cache.h"
+#include "statistics.h"
+
+/// Re-plan the remaining joins of a query if an intermediate result is that
+/// many times larger or smaller than estimated
+#define REPLAN_FACTOR 4.0
+
+/// Bushy plans are searched for queries with at most that many inputs
+#define BUSHY_PLAN_MAX_INPUTS 10
+/// A bushy plan is used if its estimated cost (the sum of the intermediate
+/// result sizes) is below that fraction of the best left-deep plan's
+#define BUSHY_PLAN_GAIN 0.8
+/// Star joins need at least that many dimensions
+#define STAR_JOIN_MIN_DIMENSIONS 2
+/// Joins the two topmost subtrees of a bushy plan in postfix form
+#define PLAN_JOIN (~0u)
+/// Follows the fact input of a star join in a cached plan
+#define PLAN_STAR (~0u - 1)
 
 class Joiner {
     private:
         /// The relations that might be joined
         std::vector<Relation> relations_;
+        /// The files of the relations (empty for relations built in memory)
+        std::vector<std::string> file_names_;
+        /// The selections of filtered scans shared across queries
+        ScanCache scan_cache_;
+        /// The join hash tables on base relations shared across queries
+        JoinTableCache join_table_cache_;
+        /// The statistics of the relations (built during preparation)
+        std::vector<RelationStatistics> statistics_;
+        /// The samples and indexes of the relations (built during preparation)
+        SamplingEstimator sampler_;
+        /// The join orders of query templates
+        PlanCache plan_cache_;
+        /// The estimated and actual sizes of executed sub-plans
+        CardinalityFeedback feedback_;
+        /// The cardinality estimator
+        CardinalityEstimator estimator_{statistics_};
+        /// Print the plan of every query with estimated and actual sizes
+        bool explain_ = false;
+        /// Misestimation factor triggering re-planning
+        double replan_factor_ = REPLAN_FACTOR;
+        /// The probe of unique-key hash tables
+        ProbeMode probe_mode_ = ProbeMode::GroupPrefetch;
+        /// The intermediate buffers of the running batch and its queries
+        Arena arena_;
+        /// Draw intermediate buffers from the arena (false: from the heap)
+        bool use_arena_ = true;
+        /// How relation files are brought into memory
+        LoadMode load_mode_ = LoadMode::Populate;
+        /// Map the statistics and indexes of relation files from snapshots
+        /// next to them (written if missing or stale)
+        bool use_snapshots_ = false;
+        /// The relations whose snapshot was used by the last preparation
+        unsigned snapshots_used_ = 0;
 
     public:
         /// Add relation
         void addRelation(const char *file_name);
         void addRelation(Relation &&relation);
+        /// Add relations, loading the files in parallel
+        void addRelations(const std::vector<std::string> &file_names);
         /// Get relation
         const Relation &getRelation(unsigned relation_id);
+        /// Build the statistics, samples and indexes of all relations
+        void buildStatistics();
         /// Joins a given set of relations
         std::string join(QueryInfo &i);
+        /// Joins a batch of queries, running sub-plans common to several
+        /// queries only once
+        std::vector<std::string> joinBatch(std::vector<QueryInfo> &queries);
 
         const std::vector<Relation> &relations() const { return relations_; }
+        /// The statistics of the relations
+        const std::vector<RelationStatistics> &statistics() const { return statistics_; }
+        /// The cardinality estimator
+        const CardinalityEstimator &estimator() const { return estimator_; }
+        /// Enable EXPLAIN output (on stderr)
+        void setExplain(bool explain) { explain_ = explain; }
+        /// Set the misestimation factor triggering re-planning
+        void setReplanFactor(double factor) { replan_factor_ = factor; }
+        /// Set the probe of unique-key hash tables
+        void setProbeMode(ProbeMode mode) { probe_mode_ = mode; }
+        /// Draw intermediate buffers from the arena or from the heap
+        void setUseArena(bool use_arena) { use_arena_ = use_arena; }
+        /// Set how relation files are brought into memory
+        void setLoadMode(LoadMode mode) { load_mode_ = mode; }
+        /// Use (and write) snapshots of the preparation results
+        void setUseSnapshots(bool use_snapshots) { use_snapshots_ = use_snapshots; }
+        /// The relations whose snapshot was used by the last preparation
+        unsigned snapshots_used() const { return snapshots_used_; }
+        /// The arena of intermediate buffers
+        Arena &arena() { return arena_; }
+        /// The filtered-scan cache
+        ScanCache &scan_cache() { return scan_cache_; }
+        /// The join hash-table cache
+        JoinTableCache &join_table_cache() { return join_table_cache_; }
+        /// The cardinality feedback store
+        CardinalityFeedback &feedback() { return feedback_; }
+        /// The plan cache
+        PlanCache &plan_cache() { return plan_cache_; }
 
     private:
+        /// A materialized sub-plan shared by several queries of a batch
+        struct SharedInput {
+            /// The producing operator (already run)
+            std::shared_ptr<Operator> op;
+            /// Mapping from bindings of the consuming query to the producer's
+            std::unordered_map<unsigned, unsigned> bindings;
+            /// The predicate of the consuming query answered by the producer
+            unsigned predicate;
+        };
+
+        /// An input of the remaining join plan: a base relation or a
+        /// materialized intermediate result
+        struct PlanInput {
+            /// The bindings covered by the input
+            std::set<unsigned> bindings;
+            /// The materialized result (nullptr: base relation, scanned when used)
+            std::shared_ptr<Operator> op;
+            /// Mapping from bindings of the query to the materialized result's
+            std::unordered_map<unsigned, unsigned> mapping;
+            /// Actual size divided by the estimated size (materialized inputs)
+            double correction = 1.0;
+            /// The semi-joins of key lookups were applied to the inputs joined
+            /// into the result (they are not applied again when it is read)
+            bool semi_joined = false;
+        };
+
+        /// A relation that is only joined for a lookup of a unique key
+        struct KeyLookup {
+            /// The looked up binding (not joined)
+            unsigned binding;
+            /// The column of the remaining query and the key column
+            SelectInfo column, key;
+            /// All values of the column are keys: the join is dropped,
+            /// otherwise it becomes a semi-join
+            bool contained;
+        };
+
+        /// Find the bindings that contribute no selections or filters of
+        /// their own and are joined by a single predicate on a unique key
+        /// (marks the predicates as applied)
+        std::vector<KeyLookup> findKeyLookups(const QueryInfo &query,
+                                              const std::set<unsigned> &covered,
+                                              std::vector<bool> &applied);
+        /// Estimated size of joining a set of inputs
+        double estimateInputs(const QueryInfo &query, const std::vector<PlanInput> &inputs,
+                              const std::vector<unsigned> &ids);
+        /// Order the inputs of a query for a left-deep plan: greedily join the
+        /// connected input giving the smallest estimated intermediate result
+        /// (without statistics: in the order of the predicates)
+        std::vector<unsigned> planJoinOrder(const QueryInfo &query,
+                                            const std::vector<PlanInput> &inputs);
+        /// Plan a bushy join tree over the inputs minimizing the sum of the
+        /// estimated intermediate results. Returns the tree in postfix form
+        /// (input ids and PLAN_JOIN) if it beats the best left-deep plan by
+        /// BUSHY_PLAN_GAIN, otherwise nothing
+        std::vector<unsigned> planBushy(const QueryInfo &query,
+                                        const std::vector<PlanInput> &inputs);
+        /// Build and run a bushy plan; the independent subtrees of a join
+        /// run concurrently. Returns the result as a materialized input
+        PlanInput runBushy(QueryInfo &query, const std::vector<PlanInput> &inputs,
+                           const std::vector<unsigned> &tree, std::vector<bool> &applied,
+                           const std::vector<KeyLookup> &lookups,
+                           std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed);
+        /// Find a star: a fact input joined by a single predicate with every
+        /// other base relation input, which are not joined among each other
+        /// and estimated to be no larger. Returns the fact input, or the
+        /// number of inputs if there is no star
+        unsigned findStar(const QueryInfo &query, const std::vector<PlanInput> &inputs,
+                          const std::vector<bool> &applied);
+        /// Build and run a star join. Returns the result as a materialized input
+        PlanInput runStar(QueryInfo &query, const std::vector<PlanInput> &inputs,
+                          unsigned fact, std::vector<bool> &applied,
+                          const std::vector<KeyLookup> &lookups,
+                          std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed);
+        /// Create the operator reading an input (and applying the predicates
+        /// and semi-joins within it)
+        std::unique_ptr<Operator> openInput(const PlanInput &input, QueryInfo &query,
+                                            std::vector<bool> &applied,
+                                            const std::vector<KeyLookup> &lookups);
+        /// Record the actual sizes of the executed sub-plans of a query
+        void recordFeedback(const QueryInfo &query,
+                            const std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed);
+        /// Joins a given set of relations, starting from a shared sub-plan
+        std::string join(QueryInfo &query, const SharedInput *shared);
+        /// Signature of one side of a join predicate (relation, filters, column)
+        std::string sideSignature(const SelectInfo &info, QueryInfo &query);
         /// Add scan to query
         std::unique_ptr<Operator> addScan(std::set<unsigned> &used_relations,
                                             const SelectInfo &info,
@@ -2,15 +2,21 @@
 
 #include <cassert>
 #include <memory>
+#include <ostream>
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 #include <set>
+#include <string>
 
+#include "arena.h"
+#include "hash_table.h"
+#include "join_cache.h"
 #include "relation.h"
 #include "parser.h"
+#include "scan_cache.h"
 
 namespace std {
     /// Simple hash function to enable use with unordered_map
@@ -29,10 +35,14 @@ class Operator {
         std::unordered_map<SelectInfo, unsigned> select_to_result_col_id_;
         /// The materialized results
         std::vector<uint64_t *> result_columns_;
-        /// The tmp results
-        std::vector<std::vector<uint64_t>> tmp_results_;
+        /// The tmp results (drawn from the arena of the query)
+        std::vector<ArenaVector<uint64_t>> tmp_results_;
         /// The result size
         uint64_t result_size_ = 0;
+        /// The estimated result size (negative if unknown)
+        double estimated_size_ = -1;
+        /// Not run because another input of the consumer was empty
+        bool skipped_ = false;
 
     public:
         /// The destructor
@@ -49,8 +59,24 @@ class Operator {
         virtual void run() = 0;
         /// Get  materialized results
         virtual std::vector<uint64_t *> getResults();
+        /// Whether the result tuples are the same in every query (scans of base
+        /// relations); sets a fingerprint of the applied filters
+        virtual bool baseFingerprint(std::string &/*fingerprint*/) const { return false; }
+        /// Whether no value of a result column occurs twice
+        virtual bool isUnique(const SelectInfo &/*info*/) const { return false; }
+        /// Describe the operator (one line)
+        virtual std::string describe() const = 0;
+        /// The input operators
+        virtual std::vector<const Operator *> children() const { return {}; }
+        /// Print the operator tree with estimated and actual result sizes
+        void explain(std::ostream &out, unsigned depth = 0, bool skipped = false) const;
 
         uint64_t result_size() const { return result_size_; }
+        /// Mark the operator as not run (its result is not needed)
+        void skip() { skipped_ = true; }
+        bool skipped() const { return skipped_; }
+        double estimated_size() const { return estimated_size_; }
+        void setEstimatedSize(double size) { estimated_size_ = size; }
 };
 
 class Scan : public Operator {
@@ -70,6 +96,17 @@ class Scan : public Operator {
         void run() override;
         /// Get  materialized results
         virtual std::vector<uint64_t *> getResults() override;
+        /// An unfiltered base relation
+        bool baseFingerprint(std::string &fingerprint) const override {
+            fingerprint.clear();
+            return true;
+        }
+        /// Key columns of the relation (stay unique under filters)
+        bool isUnique(const SelectInfo &info) const override {
+            return info.binding == relation_binding_ && relation_.isUnique(info.col_id);
+        }
+        /// Describe the operator
+        std::string describe() const override;
 };
 
 class FilterScan : public Scan {
@@ -78,19 +115,33 @@ class FilterScan : public Scan {
         std::vector<FilterInfo> filters_;
         /// The input data
         std::vector<uint64_t *> input_data_;
+        /// The cache of selections shared across queries (may be null)
+        ScanCache *cache_;
+        /// The filters as one range per column in evaluation order (the most
+        /// selective first)
+        std::vector<ColumnRange> ranges_;
+        /// The ranges are evaluated without branches
+        bool predicated_ = false;
 
     private:
-        /// Apply filter
-        bool applyFilter(uint64_t id, FilterInfo &f);
-        /// Copy tuple to result
-        void copy2Result(uint64_t id);
+        /// Order the ranges of the filters by their selectivity on a sample
+        /// of the input and choose the evaluation
+        template <typename RowId>
+        void orderRanges(const FilterKey &key, const std::vector<RowId> *candidates);
+        /// Select the qualifying tuple ids (among the candidates, if given)
+        template <typename RowId>
+        std::vector<RowId> select(const std::vector<RowId> *candidates);
+        /// The qualifying tuple ids (32-bit selections go through the cache)
+        template <typename RowId>
+        std::shared_ptr<const std::vector<RowId>> selection(const FilterKey &key);
 
     public:
         /// The constructor
-        FilterScan(const Relation &r, std::vector<FilterInfo> filters)
+        FilterScan(const Relation &r, std::vector<FilterInfo> filters,
+                ScanCache *cache = nullptr)
             : Scan(r,
                 filters[0].filter_column.binding),
-                filters_(filters) {};
+                filters_(filters), cache_(cache) {};
         /// The constructor
         FilterScan(const Relation &r, FilterInfo &filter_info)
             : FilterScan(r,
@@ -101,20 +152,76 @@ class FilterScan : public Scan {
         bool require(SelectInfo info) override;
         /// Run
         void run() override;
+        /// The evaluated ranges (after selecting)
+        const std::vector<ColumnRange> &ranges() const { return ranges_; }
+        /// The ranges were evaluated without branches
+        bool predicated() const { return predicated_; }
         /// Get  materialized results
         virtual std::vector<uint64_t *> getResults() override {
             return Operator::getResults();
         }
+        /// A filtered base relation
+        bool baseFingerprint(std::string &fingerprint) const override;
+        /// Describe the operator
+        std::string describe() const override;
+};
+
+class SharedResult : public Operator {
+    private:
+        /// The producing operator (already run, shared by several queries)
+        std::shared_ptr<Operator> input_;
+        /// Mapping from bindings of this query to bindings of the producer
+        std::unordered_map<unsigned, unsigned> bindings_;
+        /// The results of the producer
+        std::vector<uint64_t *> input_data_;
+
+    public:
+        /// The constructor
+        SharedResult(std::shared_ptr<Operator> input,
+                    std::unordered_map<unsigned, unsigned> bindings)
+            : input_(std::move(input)), bindings_(std::move(bindings)),
+            input_data_(input_->getResults()) {};
+        /// Require a column and add it to results
+        bool require(SelectInfo info) override;
+        /// Run
+        void run() override;
+        /// Get  materialized results
+        virtual std::vector<uint64_t *> getResults() override {
+            return result_columns_;
+        }
+        /// Describe the operator
+        std::string describe() const override;
+        /// The input operators
+        std::vector<const Operator *> children() const override { return {input_.get()}; }
+        /// Whether no value of a result column occurs twice
+        bool isUnique(const SelectInfo &info) const override;
+};
+
+/// Keys of a group whose slots are prefetched before any of them is probed
+#define PROBE_GROUP_SIZE 16
+
+/// How a join probes a unique-key hash table
+enum class ProbeMode {
+    /// One key after the other
+    Simple,
+    /// Prefetch the slots of a group of keys, then probe them: the cache
+    /// misses of the group overlap
+    GroupPrefetch
 };
 
 class Join : public Operator {
     private:
         /// The input operators
         std::unique_ptr<Operator> left_, right_;
-        /// The join predicate info
-        PredicateInfo p_info_;
-
-        using HT = std::unordered_multimap<uint64_t, uint64_t>;
+        /// The join predicates: the first one is used as hash key, the others
+        /// are checked during the probe
+        std::vector<PredicateInfo> p_infos_;
+        /// The cache of hash tables on base relations (may be null)
+        JoinTableCache *cache_;
+        /// Run the inputs concurrently (independent subtrees of a bushy plan)
+        bool parallel_inputs_ = false;
+        /// The probe of unique-key tables
+        ProbeMode probe_mode_ = ProbeMode::GroupPrefetch;
 
         /// Columns that have to be materialized
         std::unordered_set<SelectInfo> requested_columns_;
@@ -134,15 +241,37 @@ class Join : public Operator {
         /// The constructor
         Join(std::unique_ptr<Operator> &&left,
             std::unique_ptr<Operator> &&right,
-            const PredicateInfo &p_info)
-            : left_(std::move(left)), right_(std::move(right)), p_info_(p_info) {};
+            std::vector<PredicateInfo> p_infos,
+            JoinTableCache *cache = nullptr)
+            : left_(std::move(left)), right_(std::move(right)),
+            p_infos_(std::move(p_infos)), cache_(cache) {
+            assert(!p_infos_.empty());
+        };
+        /// The constructor
+        Join(std::unique_ptr<Operator> &&left,
+            std::unique_ptr<Operator> &&right,
+            const PredicateInfo &p_info,
+            JoinTableCache *cache = nullptr)
+            : Join(std::move(left), std::move(right),
+                std::vector<PredicateInfo>{p_info}, cache) {};
         /// Require a column and add it to results
         bool require(SelectInfo info) override;
         /// Swap relations (use smaller one as inner)
         void swap();
+        /// Run the inputs concurrently instead of one after the other (an
+        /// empty left input then no longer saves running the right one)
+        void setParallelInputs(bool parallel) { parallel_inputs_ = parallel; }
+        /// Set the probe of unique-key tables
+        void setProbeMode(ProbeMode mode) { probe_mode_ = mode; }
         /// Run
         void run() override;
         void run_small();
+        /// Describe the operator
+        std::string describe() const override;
+        /// The input operators
+        std::vector<const Operator *> children() const override {
+            return {left_.get(), right_.get()};
+        }
 };
 
 class SelfJoin : public Operator {
@@ -171,6 +300,89 @@ class SelfJoin : public Operator {
         bool require(SelectInfo info) override;
         /// Run
         void run() override;
+        /// Describe the operator
+        std::string describe() const override;
+        /// The input operators
+        std::vector<const Operator *> children() const override { return {input_.get()}; }
+        /// Filtering keeps columns unique
+        bool isUnique(const SelectInfo &info) const override { return input_->isUnique(info); }
+};
+
+/// Keeps the input tuples whose column value occurs in a column of a base
+/// relation (the relation is not joined, e.g. a lookup of a unique key)
+class SemiJoin : public Operator {
+    private:
+        /// The input operator
+        std::unique_ptr<Operator> input_;
+        /// The input column
+        SelectInfo column_;
+        /// The relation containing the values and its column
+        const Relation &lookup_;
+        SelectInfo lookup_column_;
+        /// The cache of hash tables on base relations (may be null)
+        JoinTableCache *cache_;
+        /// The required IUs
+        std::set<SelectInfo> required_IUs_;
+
+    public:
+        /// The constructor
+        SemiJoin(std::unique_ptr<Operator> &&input, const SelectInfo &column,
+                 const Relation &lookup, const SelectInfo &lookup_column,
+                 JoinTableCache *cache = nullptr)
+            : input_(std::move(input)), column_(column), lookup_(lookup),
+            lookup_column_(lookup_column), cache_(cache) {};
+        /// Require a column and add it to results
+        bool require(SelectInfo info) override;
+        /// Run
+        void run() override;
+        /// Describe the operator
+        std::string describe() const override;
+        /// The input operators
+        std::vector<const Operator *> children() const override { return {input_.get()}; }
+        /// Filtering keeps columns unique
+        bool isUnique(const SelectInfo &info) const override { return input_->isUnique(info); }
+};
+
+/// Joins a fact input with several dimension inputs: builds a hash table on
+/// every dimension and streams the fact input once. Every fact tuple probes
+/// the tables in the order of their match rates and is dropped at the first
+/// miss; only complete combinations are materialized
+class StarJoin : public Operator {
+    private:
+        /// The fact input
+        std::unique_ptr<Operator> fact_;
+        /// The dimension inputs
+        std::vector<std::unique_ptr<Operator>> dimensions_;
+        /// The predicate of every dimension (left: fact column, right:
+        /// dimension column)
+        std::vector<PredicateInfo> p_infos_;
+        /// The cache of hash tables on base relations (may be null)
+        JoinTableCache *cache_;
+        /// The requested columns and their inputs (dimension id, or -1 for the
+        /// fact input)
+        std::vector<std::pair<SelectInfo, int>> requested_columns_;
+        /// The dimensions in probe order (after running)
+        std::vector<unsigned> probe_order_;
+
+    public:
+        /// The constructor
+        StarJoin(std::unique_ptr<Operator> &&fact,
+                 std::vector<std::unique_ptr<Operator>> &&dimensions,
+                 std::vector<PredicateInfo> p_infos, JoinTableCache *cache = nullptr)
+            : fact_(std::move(fact)), dimensions_(std::move(dimensions)),
+            p_infos_(std::move(p_infos)), cache_(cache) {
+            assert(dimensions_.size() == p_infos_.size());
+        };
+        /// Require a column and add it to results
+        bool require(SelectInfo info) override;
+        /// Run
+        void run() override;
+        /// The dimensions in probe order (after running)
+        const std::vector<unsigned> &probe_order() const { return probe_order_; }
+        /// Describe the operator
+        std::string describe() const override;
+        /// The input operators
+        std::vector<const Operator *> children() const override;
 };
 
 class Checksum : public Operator {
@@ -197,4 +409,8 @@ class Checksum : public Operator {
         void run() override;
 
         const std::vector<uint64_t> &check_sums() { return check_sums_; }
+        /// Describe the operator
+        std::string describe() const override { return "Checksum"; }
+        /// The input operators
+        std::vector<const Operator *> children() const override { return {input_.get()}; }
 };
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -67,6 +68,39 @@ struct FilterInfo {
     constexpr static const char delimiterSQL[] = " and ";
 };
 
+/// Inclusive value range [low, high] of a single column
+struct ColumnRange {
+    /// Column id
+    unsigned col_id;
+    /// Lower bound (inclusive)
+    uint64_t low;
+    /// Upper bound (inclusive)
+    uint64_t high;
+
+    /// The constructor
+    ColumnRange(unsigned col_id, uint64_t low, uint64_t high)
+        : col_id(col_id), low(low), high(high) {};
+    /// The constructor of an unrestricted range
+    explicit ColumnRange(unsigned col_id)
+        : ColumnRange(col_id, 0, std::numeric_limits<uint64_t>::max()) {};
+
+    /// Intersect with a filter, returns false if the range becomes empty
+    bool restrict(const FilterInfo &f);
+    /// Express the range as filters on a column
+    void toFilters(const SelectInfo &column, std::vector<FilterInfo> &filters) const;
+
+    /// Whether a value lies in the range
+    inline bool contains(uint64_t v) const { return low <= v && v <= high; }
+    /// Whether another range lies in the range
+    inline bool contains(const ColumnRange &o) const {
+        return low <= o.low && o.high <= high;
+    }
+    /// Equality operator
+    inline bool operator==(const ColumnRange &o) const {
+        return col_id == o.col_id && low == o.low && high == o.high;
+    }
+};
+
 static const std::vector<FilterInfo::Comparison> comparisonTypes
     {FilterInfo::Comparison::Less, FilterInfo::Comparison::Greater,
      FilterInfo::Comparison::Equal};
@@ -126,6 +160,11 @@ class QueryInfo {
         /// Reset query info
         void clear();
 
+        /// Propagate filters to all columns that the join predicates make
+        /// equal and merge the filters of each column into one range.
+        /// Returns false if the filters contradict each other (empty result)
+        bool inferFilters();
+
         /// The relation ids
         const std::vector<RelationId> &relation_ids() const { return relation_ids_; }
         /// The predicates
@@ -134,6 +173,8 @@ class QueryInfo {
         const std::vector<FilterInfo> &filters() const { return filters_; }
         /// The selections
         const std::vector<SelectInfo> &selections() const { return selections_; }
+        /// The filters of a binding
+        std::vector<FilterInfo> filtersOf(unsigned binding) const;
 
     private:
         /// Parse a single predicate
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+/// Default number of query templates in the plan cache
+#define PLAN_CACHE_CAPACITY 1024
+/// A cached plan is reused while the estimated size of every scan is within
+/// this factor of the estimate the plan was chosen for
+#define PLAN_CACHE_SELECTIVITY_FACTOR 2.0
+
+/// A join plan chosen by the optimizer
+struct CachedPlan {
+    /// The join order (bindings of the query)
+    std::vector<unsigned> order;
+    /// The estimated scan sizes of the bindings the plan was chosen for
+    std::vector<double> scan_estimates;
+};
+
+/// LRU cache of join plans keyed by query template (the query without filter
+/// constants)
+class PlanCache {
+    private:
+        struct Entry {
+            /// The query template
+            std::string key;
+            /// The plan
+            CachedPlan plan;
+        };
+
+        /// The maximal number of entries
+        size_t capacity_;
+        /// The maximal deviation of the scan estimates for reusing a plan
+        double factor_;
+        /// The entries (most recently used first)
+        std::list<Entry> lru_;
+        /// Mapping from query template to entry
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        /// Protects everything above
+        std::mutex mutex_;
+
+        /// Statistics
+        uint64_t hits_ = 0, misses_ = 0, rejections_ = 0;
+
+    public:
+        /// The constructor
+        explicit PlanCache(size_t capacity = PLAN_CACHE_CAPACITY,
+                           double factor = PLAN_CACHE_SELECTIVITY_FACTOR)
+            : capacity_(capacity), factor_(factor) {};
+
+        /// The template of a query: relations, predicates, filtered columns
+        /// with their comparisons and selected bindings, but no constants
+        static std::string key(const QueryInfo &query);
+
+        /// Look up the plan of a template. A plan is only returned if the scan
+        /// estimates of the new query are close to those it was chosen for
+        bool lookup(const std::string &key, const std::vector<double> &scan_estimates,
+                    std::vector<unsigned> &order);
+        /// Insert (or replace) the plan of a template
+        void insert(const std::string &key, CachedPlan plan);
+        /// Drop all entries
+        void clear();
+
+        /// The number of reused plans, unknown templates and plans rejected
+        /// because of changed estimates
+        uint64_t hits() const { return hits_; }
+        uint64_t misses() const { return misses_; }
+        uint64_t rejections() const { return rejections_; }
+        /// The number of entries
+        size_t size() const { return lru_.size(); }
+
+        /// Print statistics
+        void report(std::ostream &out);
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -8,23 +9,98 @@
 
 using RelationId = unsigned;
 
+/// Inputs with fewer tuples than this keep 32-bit row ids in intermediate
+/// results (selections, join matches)
+#define NARROW_ROW_ID_LIMIT (1ull << 32)
+
+/// Call f with a value of the row-id type of an input with size tuples:
+/// uint32_t below NARROW_ROW_ID_LIMIT, uint64_t otherwise. Both
+/// instantiations of f are compiled and the size picks one of them
+template <typename F>
+inline decltype(auto) dispatchRowId(uint64_t size, F &&f) {
+    if (size < NARROW_ROW_ID_LIMIT)
+        return f(uint32_t());
+    return f(uint64_t());
+}
+
+/// First word of relation files of format version 2 ("RELFMTv2"; the first
+/// word of a version 1 file is its number of tuples)
+#define RELATION_V2_MAGIC 0x3276544D464C4552ull
+
+/// Binary formats of relation files
+enum class RelationFormat {
+    /// numTuples|numColumns|data
+    V1,
+    /// magic|2|numTuples|numColumns|column metadata|data
+    V2
+};
+
+/// Physical encodings of the columns of a relation file
+enum class ColumnEncoding : uint64_t {
+    /// 64-bit values
+    Plain = 0
+};
+
+/// Metadata of a column stored in version 2 relation files
+struct ColumnMetadata {
+    /// Smallest and largest value
+    uint64_t min = 0, max = 0;
+    /// Number of distinct values
+    uint64_t distinct = 0;
+    /// The values are in ascending order
+    bool sorted = false;
+    /// No value occurs twice
+    bool unique = false;
+    /// The physical encoding
+    ColumnEncoding encoding = ColumnEncoding::Plain;
+};
+
+/// Collect the metadata of a column (sorts a copy of the values)
+ColumnMetadata computeColumnMetadata(const uint64_t *column, uint64_t size);
+
+/// How the columns of a relation file are brought into memory (during the
+/// untimed preparation, except for Lazy)
+enum class LoadMode {
+    /// Mapped: the first query touching a page faults it in
+    Lazy,
+    /// Mapped and populated (read ahead and page-table entries set up)
+    Populate,
+    /// Copied into anonymous memory backed by transparent huge pages
+    /// (fewer TLB misses on random accesses, the file mapping is dropped)
+    Copy
+};
+
 class Relation {
     private:
+        /// Unmaps the memory of a loaded relation
+        struct Unmap {
+            /// The mapped bytes
+            size_t length;
+            void operator()(char *addr) const;
+        };
+
         /// Owns memory (false if it was mmaped)
         bool owns_memory_;
+        /// The file mapping or the copy of a loaded relation
+        std::unique_ptr<char, Unmap> mapping_{nullptr, Unmap{0}};
         /// The number of tuples
         uint64_t size_;
         /// The join column containing the keys
         std::vector<uint64_t *> columns_;
         //// Hash tables
         std::unordered_map<unsigned, std::unordered_map<uint64_t, std::set<unsigned>>> maps;
+        /// The columns without duplicate values (set during preparation)
+        std::vector<bool> unique_columns_;
+        /// The metadata of the columns (empty unless loaded from a version 2
+        /// file)
+        std::vector<ColumnMetadata> metadata_;
 
     public:
         /// Constructor without mmap
         Relation(uint64_t size, std::vector<uint64_t *> &&columns)
             : owns_memory_(true), size_(size), columns_(columns) {}
         /// Constructor using mmap
-        explicit Relation(const char *file_name);
+        explicit Relation(const char *file_name, LoadMode mode = LoadMode::Populate);
         /// Delete copy constructor
         Relation(const Relation &other) = delete;
         /// Move constructor
@@ -34,7 +110,8 @@ class Relation {
         ~Relation();
 
         /// Stores a relation into a file (binary)
-        void storeRelation(const std::string &file_name);
+        void storeRelation(const std::string &file_name,
+                           RelationFormat format = RelationFormat::V1);
         /// Stores a relation into a file (csv)
         void storeRelationCSV(const std::string &file_name);
         /// Dump SQL: Create and load table (PostgreSQL)
@@ -44,6 +121,17 @@ class Relation {
         uint64_t size() const { return size_; }
         /// The join column containing the keys
         const std::vector<uint64_t *> &columns() const { return columns_; }
+        /// The metadata of the columns (empty if unknown)
+        const std::vector<ColumnMetadata> &metadata() const { return metadata_; }
+        /// Mark a column as free of duplicate values
+        void setUnique(unsigned col_id, bool unique) {
+            unique_columns_.resize(columns_.size());
+            unique_columns_[col_id] = unique;
+        }
+        /// The column has no duplicate values
+        bool isUnique(unsigned col_id) const {
+            return col_id < unique_columns_.size() && unique_columns_[col_id];
+        }
 
         /// Build Hash maps (used after loading)
         void buildHashMaps();
@@ -52,6 +140,6 @@ class Relation {
 
     private:
         /// Loads data from a file
-        void loadRelation(const char *file_name);
+        void loadRelation(const char *file_name, LoadMode mode);
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "parser.h"
+#include "relation.h"
+
+/// Number of sampled tuples per relation
+#define SAMPLE_SIZE 1024
+/// Maximal number of sampled tuples of a join kept between join steps
+#define JOIN_SAMPLE_CAP (8 * SAMPLE_SIZE)
+
+/// Row ids of a column sorted by value: finds all tuples with a given value
+class ColumnIndex {
+    private:
+        /// The indexed column
+        const uint64_t *column_ = nullptr;
+        /// The row ids in value order (owned or within a snapshot mapping)
+        std::shared_ptr<const uint32_t> ids_;
+        /// The number of row ids
+        uint64_t size_ = 0;
+
+    public:
+        /// Build the index of a column
+        void build(const uint64_t *column, uint64_t size);
+        /// Use row ids sorted by value that were built before (e.g. mapped
+        /// from a snapshot)
+        void assign(const uint64_t *column, std::shared_ptr<const uint32_t> ids, uint64_t size);
+        /// The row ids in value order
+        const uint32_t *ids() const { return ids_.get(); }
+        /// The number of row ids
+        uint64_t size() const { return size_; }
+        /// The row ids of all tuples with a value
+        std::pair<const uint32_t *, const uint32_t *> equal_range(uint64_t value) const;
+};
+
+/// Estimates result sizes by evaluating filters on a random sample of every
+/// relation and join predicates by extending sampled tuples through indexes.
+/// This captures correlations between filters and join columns that the
+/// histograms miss.
+class SamplingEstimator {
+    private:
+        /// The relations
+        const std::vector<Relation> *relations_ = nullptr;
+        /// The sampled row ids of every relation (in random order)
+        std::vector<std::vector<uint64_t>> samples_;
+        /// The indexes of every column of every relation
+        std::vector<std::vector<ColumnIndex>> indexes_;
+
+    public:
+        /// Draw the samples and build the indexes (preparation phase). The
+        /// indexes of a relation may be given (e.g. from a snapshot), an empty
+        /// list of indexes is built
+        void build(const std::vector<Relation> &relations,
+                   std::vector<std::vector<ColumnIndex>> &&indexes = {});
+        /// The indexes of the columns of a relation
+        const std::vector<ColumnIndex> &indexes(RelationId rel_id) const { return indexes_[rel_id]; }
+        /// Samples are available
+        bool ready() const { return relations_ != nullptr; }
+
+        /// Estimated number of tuples of a binding passing its filters.
+        /// Returns false if no sampled tuple qualifies (size is then an upper
+        /// bound)
+        bool estimateScan(const QueryInfo &query, unsigned binding, double &size) const;
+        /// Estimated result size of joining a set of bindings. Returns false if
+        /// no sampled tuple qualifies (size is then an upper bound) or the
+        /// deadline (omp_get_wtime) passes (size is then infinite)
+        bool estimate(const QueryInfo &query, const std::set<unsigned> &bindings,
+                    double deadline, double &size) const;
+};
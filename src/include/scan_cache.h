@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+/// Default memory budget of the filtered-scan cache (bytes)
+#define SCAN_CACHE_BUDGET (1ull << 30)
+
+/// The filters of one relation normalized into one range per column
+class FilterKey {
+    private:
+        /// The relation id
+        RelationId rel_id_;
+        /// The column ranges (sorted by column id)
+        std::vector<ColumnRange> ranges_;
+        /// No tuple can pass the filters (e.g. >5 and <3)
+        bool unsatisfiable_ = false;
+
+    public:
+        /// The constructor
+        FilterKey(RelationId rel_id, const std::vector<FilterInfo> &filters);
+
+        /// The relation id
+        RelationId rel_id() const { return rel_id_; }
+        /// The column ranges
+        const std::vector<ColumnRange> &ranges() const { return ranges_; }
+        /// No tuple can pass the filters
+        bool unsatisfiable() const { return unsatisfiable_; }
+
+        /// Every tuple passing this key also passes the other key
+        bool implies(const FilterKey &other) const;
+        /// Canonical text (relation id and ranges)
+        std::string str() const;
+};
+
+/// A selection vector: the ids of the qualifying tuples in ascending order.
+/// Only selections with 32-bit row ids are cached
+using Selection = std::shared_ptr<const std::vector<uint32_t>>;
+
+/// LRU cache of selection vectors of filtered scans shared across queries
+class ScanCache {
+    private:
+        struct Entry {
+            /// The normalized filters
+            FilterKey key;
+            /// The qualifying tuple ids
+            Selection ids;
+            /// The memory held by the entry
+            size_t bytes;
+        };
+
+        /// The memory budget (bytes)
+        size_t budget_;
+        /// The memory in use (bytes)
+        size_t used_ = 0;
+        /// The entries (most recently used first)
+        std::list<Entry> lru_;
+        /// Mapping from canonical key to entry
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        /// The entries of every relation (candidates for partial hits)
+        std::unordered_map<RelationId, std::vector<std::list<Entry>::iterator>> by_relation_;
+        /// Protects everything above
+        std::mutex mutex_;
+
+        /// Statistics
+        uint64_t hits_ = 0, partial_hits_ = 0, misses_ = 0, evictions_ = 0;
+
+    private:
+        /// Evict least recently used entries until the budget is met
+        void evict();
+
+    public:
+        /// The constructor
+        explicit ScanCache(size_t budget = SCAN_CACHE_BUDGET) : budget_(budget) {};
+
+        /// Look up a filtered scan. Returns the exact selection (exact = true),
+        /// the smallest cached selection that contains the result (exact = false),
+        /// or nullptr
+        Selection lookup(const FilterKey &key, bool &exact);
+        /// Insert the selection of a filtered scan
+        void insert(const FilterKey &key, Selection ids);
+        /// Drop all entries
+        void clear();
+
+        /// The number of exact, partial and failed lookups
+        uint64_t hits() const { return hits_; }
+        uint64_t partial_hits() const { return partial_hits_; }
+        uint64_t misses() const { return misses_; }
+        /// The memory in use (bytes)
+        size_t used() const { return used_; }
+        /// The number of entries
+        size_t size() const { return lru_.size(); }
+
+        /// Print statistics
+        void report(std::ostream &out);
+};
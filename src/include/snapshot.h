@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "relation.h"
+#include "sampling.h"
+#include "statistics.h"
+
+/// Identifies snapshot files ("SNAPSHOT" in little-endian byte order)
+#define SNAPSHOT_MAGIC 0x544F485350414E53ull
+/// Format version of snapshots (bump on every layout change)
+#define SNAPSHOT_VERSION 1
+/// File name suffix of the snapshot of a relation file
+#define SNAPSHOT_SUFFIX ".snapshot"
+
+/// Hash of the contents of a relation (its size and all column values)
+uint64_t contentHash(const Relation &relation);
+
+/// Snapshot of the preparation results of a relation, stored next to its
+/// file: the column statistics (without foreign-key references, which
+/// depend on the other relations) and the column indexes. A snapshot is
+/// only used for a relation with the content hash it was written for.
+///
+/// Layout (64-bit words): magic, version, content hash, tuples, columns,
+/// then for every column: min, max, distinct, unique, histogram interval
+/// width, histogram intervals, Bloom filter words, followed by the interval
+/// counts, the Bloom filter words and the index row ids (32 bits each,
+/// padded to a word). Indexes are used in place from the mapping.
+class Snapshot {
+    public:
+        /// Store the snapshot of a relation (false if it cannot be written)
+        static bool store(const std::string &file_name, uint64_t hash,
+                          const RelationStatistics &statistics,
+                          const std::vector<ColumnIndex> &indexes);
+        /// Map the snapshot of a relation. Returns false (and leaves the
+        /// outputs untouched) if it is missing, of another version or of
+        /// other contents
+        static bool load(const std::string &file_name, uint64_t hash,
+                         const Relation &relation, RelationStatistics &statistics,
+                         std::vector<ColumnIndex> &indexes);
+};
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 #include <stdint.h>
+#include <cstddef>
+
+#include "relation.h"
+
+/// Number of intervals of the column histograms
+#define HISTOGRAM_INTERVALS 256
 
 
 // histogram of uint64_tegers; each interval is left-inclusive and right-exclusive
@@ -14,45 +21,122 @@ class Histogram {
     public:
         Histogram(uint64_t interval_width);
         Histogram(uint64_t interval_width, uint64_t estimated_histogram_max);
+        Histogram(uint64_t interval_width, std::vector<size_t> &&interval_count);
         ~Histogram() {}
 
-        inline std::size_t get_number_of_intervals() {
+        inline std::size_t get_number_of_intervals() const {
             return interval_count.size();
         }
 
-        inline uint64_t get_histogram_min() {
+        inline std::size_t get_interval_width() const {
+            return interval_width;
+        }
+
+        inline const std::vector<size_t> &get_interval_counts() const {
+            return interval_count;
+        }
+
+        inline uint64_t get_histogram_min() const {
             return 0;
         }
 
-        inline uint64_t get_histogram_max() {
+        inline uint64_t get_histogram_max() const {
             if (get_number_of_intervals() > 0)
                 return get_number_of_intervals() * interval_width - 1;
             else
                 return 0;
         }
 
-        inline uint64_t get_interval_index(uint64_t entry) {
+        inline uint64_t get_interval_index(uint64_t entry) const {
             return entry / interval_width;
         }
 
         void add_entry(uint64_t v);
 
-        std::size_t get_total_number_of_records();
+        std::size_t get_total_number_of_records() const;
+
+        std::size_t get_number_of_records_geq(uint64_t threshold) const;
+
+        std::size_t get_number_of_records_gt(uint64_t threshold) const;
 
-        std::size_t get_number_of_records_geq(uint64_t threshold);
+        std::size_t get_number_of_records_leq(uint64_t threshold) const;
 
-        std::size_t get_number_of_records_gt(uint64_t threshold);
+        std::size_t get_number_of_records_lt(uint64_t threshold) const;
 
-        std::size_t get_number_of_records_leq(uint64_t threshold);
+        std::size_t get_number_of_records_geq_leq(uint64_t low, uint64_t high) const;
 
-        std::size_t get_number_of_records_lt(uint64_t threshold);
+        std::size_t get_number_of_records_geq_lt(uint64_t low, uint64_t high) const;
 
-        std::size_t get_number_of_records_geq_leq(uint64_t low, uint64_t high);
+        std::size_t get_number_of_records_gt_leq(uint64_t low, uint64_t high) const;
 
-        std::size_t get_number_of_records_geq_lt(uint64_t low, uint64_t high);
+        std::size_t get_number_of_records_gt_lt(uint64_t low, uint64_t high) const;
+};
+
+/// Bits of the Bloom filter of a column per distinct value (about 2% false
+/// positives with three probes)
+#define BLOOM_FILTER_BITS_PER_VALUE 8
+
+/// Bloom filter of the values of a column. An empty filter contains every
+/// value (nothing is known)
+class BloomFilter {
+    private:
+        /// The bits
+        std::vector<uint64_t> words_;
+        /// The number of bits minus one (a power of two minus one)
+        uint64_t mask_ = 0;
+
+        /// The bit positions of a value
+        void positions(uint64_t value, uint64_t (&bits)[3]) const;
 
-        std::size_t get_number_of_records_gt_leq(uint64_t low, uint64_t high);
+    public:
+        /// Build the filter of a list of values (with distinct different
+        /// values, which size the filter; 0: all values differ)
+        void build(const uint64_t *values, uint64_t count, uint64_t distinct = 0);
+        /// Restore a filter from its bits (a power of two of words, or none)
+        void assign(std::vector<uint64_t> &&words);
+        /// The bits
+        const std::vector<uint64_t> &words() const { return words_; }
+        /// The value might occur (false: it does not occur)
+        bool mayContain(uint64_t value) const;
+        /// The memory held by the filter (bytes)
+        size_t memory() const { return words_.size() * sizeof(uint64_t); }
+};
+
+/// Statistics of a single column
+struct ColumnStatistics {
+    /// Smallest and largest value
+    uint64_t min = 0, max = 0;
+    /// Number of distinct values
+    uint64_t distinct = 0;
+    /// No value occurs twice (a key)
+    bool unique = false;
+    /// The unique columns (relation id, column id) containing every value of
+    /// this column (foreign-key references)
+    std::vector<std::pair<RelationId, unsigned>> references;
+    /// Value distribution
+    Histogram histogram;
+    /// The values (empty if all values within [min, max] occur)
+    BloomFilter values;
+
+    /// The constructor
+    ColumnStatistics() : histogram(1) {}
+};
 
-        std::size_t get_number_of_records_gt_lt(uint64_t low, uint64_t high);
+/// Statistics of a relation
+struct RelationStatistics {
+    /// The number of tuples
+    uint64_t size = 0;
+    /// The column statistics
+    std::vector<ColumnStatistics> columns;
 };
 
+/// Collect the statistics of a column. Given the metadata of the column (from
+/// a version 2 relation file), its values are not sorted
+ColumnStatistics computeColumnStatistics(const uint64_t *column, uint64_t size,
+                                         const ColumnMetadata *metadata = nullptr);
+/// Collect the statistics of all columns of a relation (in parallel)
+RelationStatistics computeRelationStatistics(const Relation &relation);
+/// Find the columns whose values are all contained in a unique column of
+/// some relation and record them as references
+void detectForeignKeys(const std::vector<Relation> &relations,
+                       std::vector<RelationStatistics> &statistics);
@@ -17,6 +17,9 @@ void get_time_ptrs(double *join_prep_time, double *join_build_time, double *join
                    double *self_join_prep_time, double *self_join_probing_time, double *self_join_materialization_time,
                    double *check_sum_time, double *filter_time);
 
+// Page faults of the process so far (getrusage)
+void get_page_faults(long *minor, long *major);
+
 // Timer
 void reset_time();
 
@@ -34,4 +37,6 @@ double * get_join_probing_time();
 double * get_join_build_time();
 double * get_join_materialization_time();
 double * get_checksum_time();
+double * get_semi_join_time();
+double * get_star_join_time();
 
@@ -0,0 +1,99 @@
+#include "join_cache.h"
+
+#include <exception>
+
+using namespace::std;
+
+// The cache key of a table on a (filtered) base relation column
+string JoinTableCache::key(RelationId rel_id, unsigned col_id,
+                           const string &filter_fingerprint) {
+    return to_string(rel_id) + '.' + to_string(col_id) + '#' + filter_fingerprint;
+}
+
+// Evict least recently used entries until the budget is met
+void JoinTableCache::evict() {
+    while (used_ > budget_ && !lru_.empty()) {
+        auto &victim = lru_.back();
+        used_ -= victim.bytes;
+        index_.erase(victim.key);
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+// Get the table of a key or build it
+SharedHashTable JoinTableCache::get(const string &key, bool repeated_only,
+                                    const function<SharedHashTable()> &build) {
+    unique_lock<mutex> lock(mutex_);
+
+    auto iter = index_.find(key);
+    if (iter != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        ++hits_;
+        return iter->second->table;
+    }
+    auto pending = building_.find(key);
+    if (pending != building_.end()) {
+        // Another query is building the table right now
+        auto future = pending->second;
+        ++hits_;
+        lock.unlock();
+        return future.get();
+    }
+
+    ++misses_;
+    // Keys requested only once would accumulate forever: start counting
+    // afresh when there are too many
+    if (repeated_only && !uses_.count(key) && uses_.size() >= JOIN_TABLE_CACHE_MAX_COUNTED)
+        uses_.clear();
+    if (repeated_only && ++uses_[key] < JOIN_TABLE_CACHE_MIN_USES) {
+        lock.unlock();
+        return build();
+    }
+
+    promise<SharedHashTable> built;
+    building_.emplace(key, built.get_future().share());
+    lock.unlock();
+
+    SharedHashTable table;
+    try {
+        table = build();
+    } catch (...) {
+        built.set_exception(current_exception());
+        lock.lock();
+        building_.erase(key);
+        throw;
+    }
+    built.set_value(table);
+
+    lock.lock();
+    building_.erase(key);
+    uses_.erase(key);
+    size_t bytes = table->memory();
+    if (bytes <= budget_) {
+        lru_.push_front(Entry{key, table, bytes});
+        index_.emplace(key, lru_.begin());
+        used_ += bytes;
+        evict();
+    }
+    return table;
+}
+
+// Drop all entries
+void JoinTableCache::clear() {
+    lock_guard<mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    uses_.clear();
+    used_ = 0;
+}
+
+// Print statistics
+void JoinTableCache::report(ostream &out) {
+    lock_guard<mutex> lock(mutex_);
+    uint64_t requests = hits_ + misses_;
+    out << "Join table cache: " << requests << " requests, " << hits_ << " hits ("
+        << (requests ? 100.0 * hits_ / requests : 0.0) << "%), " << evictions_
+        << " evictions, " << lru_.size() << " entries, "
+        << used_ / (1024.0 * 1024.0) << " MB" << endl;
+}
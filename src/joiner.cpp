@@ -1,7 +1,11 @@
 #include "joiner.h"
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -10,34 +14,72 @@
 #include <vector>
 
 #include "parser.h"
+#include "snapshot.h"
 
 namespace {
 
-    enum QueryGraphProvides { Left, Right, Both, None };
+    // The predicate connects two disjoint sets of bindings
+    bool connects(const PredicateInfo &p, const std::set<unsigned> &a,
+                  const std::set<unsigned> &b) {
+        return (a.count(p.left.binding) && b.count(p.right.binding))
+            || (a.count(p.right.binding) && b.count(p.left.binding));
+    }
+
+    // Maps every binding onto itself
+    std::unordered_map<unsigned, unsigned> identityBindings(const std::set<unsigned> &bindings) {
+        std::unordered_map<unsigned, unsigned> mapping;
+        for (auto binding : bindings)
+            mapping[binding] = binding;
+        return mapping;
+    }
 
-    // Analyzes inputs of join
-    QueryGraphProvides analyzeInputOfJoin(std::set<unsigned> &usedRelations,
-                                          SelectInfo &leftInfo,
-                                          SelectInfo &rightInfo) {
-        bool used_left = usedRelations.count(leftInfo.binding);
-        bool used_right = usedRelations.count(rightInfo.binding);
+    // Collects the columns of a binding used by predicates or selections
+    std::set<unsigned> collectColumns(const QueryInfo &query, unsigned binding) {
+        std::set<unsigned> columns;
+        for (auto &p : query.predicates()) {
+            if (p.left.binding == binding) columns.insert(p.left.col_id);
+            if (p.right.binding == binding) columns.insert(p.right.col_id);
+        }
+        for (auto &s : query.selections()) {
+            if (s.binding == binding) columns.insert(s.col_id);
+        }
+        return columns;
+    }
 
-        if (used_left ^ used_right)
-            return used_left ? QueryGraphProvides::Left : QueryGraphProvides::Right;
-        if (used_left && used_right)
-            return QueryGraphProvides::Both;
-        return QueryGraphProvides::None;
+    // The result of a query without qualifying tuples
+    std::string nullResult(const QueryInfo &query) {
+        std::string out;
+        for (unsigned i = 0; i < query.selections().size(); ++i) {
+            out += "NULL";
+            if (i < query.selections().size() - 1)
+                out += " ";
+        }
+        return out + "\n";
     }
 
 }
 
 // Loads a relation_ from disk
 void Joiner::addRelation(const char *file_name) {
-    relations_.emplace_back(file_name);
+    relations_.emplace_back(file_name, load_mode_);
+    file_names_.emplace_back(file_name);
 }
 
 void Joiner::addRelation(Relation &&relation) {
     relations_.emplace_back(std::move(relation));
+    file_names_.emplace_back();
+}
+
+// Loads relations from disk in parallel (in the order of the file names)
+void Joiner::addRelations(const std::vector<std::string> &file_names) {
+    std::vector<std::unique_ptr<Relation>> loaded(file_names.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < file_names.size(); ++i)
+        loaded[i] = std::make_unique<Relation>(file_names[i].c_str(), load_mode_);
+    relations_.reserve(relations_.size() + loaded.size());
+    for (auto &relation : loaded)
+        relations_.emplace_back(std::move(*relation));
+    file_names_.insert(file_names_.end(), file_names.begin(), file_names.end());
 }
 
 // Loads a relation from disk
@@ -50,71 +92,763 @@ const Relation &Joiner::getRelation(unsigned relation_id) {
     return relations_[relation_id];
 }
 
+// Build the statistics (including keys and foreign keys), samples and indexes
+// of all relations
+void Joiner::buildStatistics() {
+    statistics_.assign(relations_.size(), {});
+    std::vector<std::vector<ColumnIndex>> indexes(relations_.size());
+    std::vector<uint64_t> hashes(relations_.size());
+    std::vector<bool> snapshot_used(relations_.size());
+    snapshots_used_ = 0;
+    for (unsigned r = 0; r < relations_.size(); ++r) {
+        if (use_snapshots_ && !file_names_[r].empty()) {
+            hashes[r] = contentHash(relations_[r]);
+            snapshot_used[r] = Snapshot::load(file_names_[r] + SNAPSHOT_SUFFIX, hashes[r],
+                                              relations_[r], statistics_[r], indexes[r]);
+            snapshots_used_ += snapshot_used[r];
+        }
+        if (!snapshot_used[r])
+            statistics_[r] = computeRelationStatistics(relations_[r]);
+    }
+    detectForeignKeys(relations_, statistics_);
+    for (unsigned r = 0; r < relations_.size(); ++r) {
+        for (unsigned c = 0; c < statistics_[r].columns.size(); ++c)
+            relations_[r].setUnique(c, statistics_[r].columns[c].unique);
+    }
+    sampler_.build(relations_, std::move(indexes));
+    if (use_snapshots_) {
+        for (unsigned r = 0; r < relations_.size(); ++r) {
+            if (!file_names_[r].empty() && !snapshot_used[r])
+                Snapshot::store(file_names_[r] + SNAPSHOT_SUFFIX, hashes[r],
+                                statistics_[r], sampler_.indexes(r));
+        }
+    }
+    estimator_.setSampler(&sampler_);
+    estimator_.setFeedback(&feedback_);
+}
+
 // Add scan to query
 std::unique_ptr<Operator> Joiner::addScan(std::set<unsigned> &used_relations,
                                           const SelectInfo &info,
                                           QueryInfo &query) {
     used_relations.emplace(info.binding);
-    std::vector<FilterInfo> filters;
-    for (auto &f : query.filters()) {
-        if (f.filter_column.binding == info.binding) {
-            filters.emplace_back(f);
-        }
-    }
-    return !filters.empty() ?
-        std::make_unique<FilterScan>(getRelation(info.rel_id), filters)
+    auto filters = query.filtersOf(info.binding);
+    std::unique_ptr<Operator> scan = !filters.empty() ?
+        std::make_unique<FilterScan>(getRelation(info.rel_id), filters,
+                                        &scan_cache_)
                           : std::make_unique<Scan>(getRelation(info.rel_id),
                                                   info.binding);
+    if (estimator_.ready())
+        scan->setEstimatedSize(estimator_.estimateScan(query, info.binding));
+    return scan;
+}
+
+// Signature of one side of a join predicate (relation, filters, column)
+std::string Joiner::sideSignature(const SelectInfo &info, QueryInfo &query) {
+    return FilterKey(info.rel_id, query.filtersOf(info.binding)).str()
+        + "." + std::to_string(info.col_id);
 }
 
 // Executes a join query
 std::string Joiner::join(QueryInfo &query) {
-    std::set<unsigned> used_relations;
+    // Contradictory filters or constants the statistics rule out: no need to
+    // run any operator
+    if (!query.inferFilters() || estimator_.provesEmpty(query))
+        return nullResult(query);
+    return join(query, nullptr);
+}
 
-    // We always start with the first join predicate and append the other joins
-    // to it (--> left-deep join trees). You might want to choose a smarter
-    // join ordering ...
-    const auto &firstJoin = query.predicates()[0];
-    std::unique_ptr<Operator> left, right;
-    left = addScan(used_relations, firstJoin.left, query);
-    right = addScan(used_relations, firstJoin.right, query);
-    std::unique_ptr<Operator>
-        root = std::make_unique<Join>(move(left), move(right), firstJoin);
-
-    auto predicates_copy = query.predicates();
-    for (unsigned i = 1; i < predicates_copy.size(); ++i) {
-        auto &p_info = predicates_copy[i];
-        auto &left_info = p_info.left;
-        auto &right_info = p_info.right;
-
-        switch (analyzeInputOfJoin(used_relations, left_info, right_info)) {
-            case QueryGraphProvides::Left:left = move(root);
-                right = addScan(used_relations, right_info, query);
-                root = std::make_unique<Join>(move(left), move(right), p_info);
-                break;
-            case QueryGraphProvides::Right:
-                left = addScan(used_relations,
-                                left_info,
-                                query);
-                right = move(root);
-                root = std::make_unique<Join>(move(left), move(right), p_info);
-                break;
-            case QueryGraphProvides::Both:
-                // All relations of this join are already used somewhere else in the
-                // query. Thus, we have either a cycle in our join graph or more than
-                // one join predicate per join.
-                root = std::make_unique<SelfJoin>(move(root), p_info);
-                break;
-            case QueryGraphProvides::None:
-                // Process this predicate later when we can connect it to the other
-                // joins. We never have cross products.
-                predicates_copy.push_back(p_info);
+// Estimated size of joining a set of inputs
+double Joiner::estimateInputs(const QueryInfo &query, const std::vector<PlanInput> &inputs,
+                              const std::vector<unsigned> &ids) {
+    std::set<unsigned> bindings;
+    double correction = 1.0;
+    for (auto id : ids) {
+        bindings.insert(inputs[id].bindings.begin(), inputs[id].bindings.end());
+        correction *= inputs[id].correction;
+    }
+    return estimator_.estimate(query, bindings) * correction;
+}
+
+// Order the inputs of a query for a left-deep plan
+std::vector<unsigned> Joiner::planJoinOrder(const QueryInfo &query,
+                                            const std::vector<PlanInput> &inputs) {
+    std::vector<unsigned> order;
+    std::set<unsigned> joined;
+    std::vector<bool> in_order(inputs.size(), false);
+    auto add = [&](unsigned id) {
+        order.push_back(id);
+        in_order[id] = true;
+        joined.insert(inputs[id].bindings.begin(), inputs[id].bindings.end());
+    };
+
+    if (!estimator_.ready()) {
+        // Follow the predicates: start with the materialized input or the
+        // first predicate and append the other inputs as they get connected
+        unsigned start = 0;
+        if (!inputs[0].op) {
+            auto binding = query.predicates().empty() ? 0 : query.predicates()[0].left.binding;
+            while (!inputs[start].bindings.count(binding))
+                ++start;
+        }
+        add(start);
+        while (order.size() < inputs.size()) {
+            unsigned next = inputs.size();
+            for (auto &p : query.predicates()) {
+                for (unsigned id = 0; id < inputs.size() && next == inputs.size(); ++id) {
+                    if (!in_order[id] && connects(p, joined, inputs[id].bindings))
+                        next = id;
+                }
+            }
+            // We never have cross products
+            if (next == inputs.size())
                 break;
-        };
+            add(next);
+        }
+        return order;
+    }
+
+    // Start with the connected pair with the smallest estimated result ...
+    unsigned best_left = 0, best_right = inputs.size();
+    double best_size = 0.0;
+    for (unsigned i = 0; i < inputs.size(); ++i) {
+        for (unsigned j = i + 1; j < inputs.size(); ++j) {
+            bool connected = false;
+            for (auto &p : query.predicates())
+                connected |= connects(p, inputs[i].bindings, inputs[j].bindings);
+            if (!connected)
+                continue;
+            double size = estimateInputs(query, inputs, {i, j});
+            if (best_right == inputs.size() || size < best_size) {
+                best_left = i;
+                best_right = j;
+                best_size = size;
+            }
+        }
+    }
+    add(best_left);
+    if (best_right == inputs.size())
+        return order;
+    add(best_right);
+
+    // ... and greedily append the connected input giving the smallest
+    // intermediate result
+    while (order.size() < inputs.size()) {
+        unsigned next = inputs.size();
+        double next_size = 0.0;
+        for (unsigned id = 0; id < inputs.size(); ++id) {
+            if (in_order[id])
+                continue;
+            bool connected = false;
+            for (auto &p : query.predicates())
+                connected |= connects(p, joined, inputs[id].bindings);
+            if (!connected)
+                continue;
+            auto ids = order;
+            ids.push_back(id);
+            double size = estimateInputs(query, inputs, ids);
+            if (next == inputs.size() || size < next_size) {
+                next = id;
+                next_size = size;
+            }
+        }
+        if (next == inputs.size())
+            break;
+        add(next);
+    }
+    return order;
+}
+
+// Plan a bushy join tree minimizing the sum of the intermediate results
+std::vector<unsigned> Joiner::planBushy(const QueryInfo &query,
+                                        const std::vector<PlanInput> &inputs) {
+    unsigned num_inputs = inputs.size();
+    if (!estimator_.ready() || num_inputs < 4 || num_inputs > BUSHY_PLAN_MAX_INPUTS)
+        return {};
+
+    // The inputs connected to every input (as bit sets)
+    std::vector<uint32_t> neighbors(num_inputs, 0);
+    for (auto &p : query.predicates()) {
+        for (unsigned i = 0; i < num_inputs; ++i) {
+            for (unsigned j = 0; j < num_inputs; ++j) {
+                if (i != j && connects(p, inputs[i].bindings, inputs[j].bindings))
+                    neighbors[i] |= 1u << j;
+            }
+        }
+    }
+    auto reachable = [&](uint32_t set) {
+        uint32_t reached = set & -set;
+        for (uint32_t last = 0; last != reached;) {
+            last = reached;
+            for (unsigned i = 0; i < num_inputs; ++i) {
+                if (reached & (1u << i))
+                    reached |= neighbors[i] & set;
+            }
+        }
+        return reached;
+    };
+
+    // Dynamic programming over the connected sets of inputs (subsets are
+    // numerically smaller than their supersets)
+    const double none = std::numeric_limits<double>::infinity();
+    uint32_t all = (1u << num_inputs) - 1;
+    std::vector<double> bushy(all + 1, none), linear(all + 1, none);
+    std::vector<uint32_t> split(all + 1, 0);
+    for (unsigned i = 0; i < num_inputs; ++i)
+        bushy[1u << i] = linear[1u << i] = 0.0;
+    for (uint32_t set = 1; set <= all; ++set) {
+        if (!(set & (set - 1)) || reachable(set) != set)
+            continue;
+        std::vector<unsigned> ids;
+        for (unsigned i = 0; i < num_inputs; ++i) {
+            if (set & (1u << i))
+                ids.push_back(i);
+        }
+        double size = estimateInputs(query, inputs, ids);
+        // Left-deep: one input joins the rest
+        for (auto i : ids) {
+            uint32_t rest = set & ~(1u << i);
+            if (linear[rest] != none && (neighbors[i] & rest))
+                linear[set] = std::min(linear[set], linear[rest] + size);
+        }
+        // Bushy: two connected halves (each split once)
+        for (uint32_t half = (set - 1) & set; half; half = (half - 1) & set) {
+            uint32_t other = set & ~half;
+            if (half < other || bushy[half] == none || bushy[other] == none)
+                continue;
+            double cost = bushy[half] + bushy[other] + size;
+            if (cost < bushy[set]) {
+                bushy[set] = cost;
+                split[set] = half;
+            }
+        }
+    }
+    if (bushy[all] == none || bushy[all] >= BUSHY_PLAN_GAIN * linear[all])
+        return {};
+
+    std::vector<unsigned> tree;
+    std::function<void(uint32_t)> emit = [&](uint32_t set) {
+        if (!(set & (set - 1))) {
+            tree.push_back(__builtin_ctz(set));
+            return;
+        }
+        emit(split[set]);
+        emit(set & ~split[set]);
+        tree.push_back(PLAN_JOIN);
+    };
+    emit(all);
+    return tree;
+}
+
+// Build and run a bushy plan
+Joiner::PlanInput Joiner::runBushy(QueryInfo &query, const std::vector<PlanInput> &inputs,
+                                   const std::vector<unsigned> &tree, std::vector<bool> &applied,
+                                   const std::vector<KeyLookup> &lookups,
+                                   std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed) {
+    struct Subtree {
+        std::unique_ptr<Operator> op;
+        std::set<unsigned> bindings;
+        double correction;
+        bool join;
+    };
+    auto &predicates = query.predicates();
+    std::vector<Subtree> stack;
+    for (auto entry : tree) {
+        if (entry != PLAN_JOIN) {
+            auto &input = inputs[entry];
+            auto op = openInput(input, query, applied, lookups);
+            if (!input.op)
+                executed.emplace_back(input.bindings, op.get());
+            stack.push_back(Subtree{move(op), input.bindings, input.correction, false});
+            continue;
+        }
+        Subtree right = std::move(stack.back());
+        stack.pop_back();
+        Subtree left = std::move(stack.back());
+        stack.pop_back();
+
+        std::vector<PredicateInfo> join_predicates;
+        for (unsigned i = 0; i < predicates.size(); ++i) {
+            if (!applied[i] && connects(predicates[i], left.bindings, right.bindings)) {
+                applied[i] = true;
+                join_predicates.push_back(predicates[i]);
+            }
+        }
+        Subtree joined;
+        joined.bindings = left.bindings;
+        joined.bindings.insert(right.bindings.begin(), right.bindings.end());
+        joined.correction = left.correction * right.correction;
+        joined.join = true;
+        auto join = std::make_unique<Join>(move(left.op), move(right.op), join_predicates,
+                                           &join_table_cache_);
+        join->setEstimatedSize(estimator_.estimate(query, joined.bindings) * joined.correction);
+        join->setParallelInputs(left.join && right.join);
+        join->setProbeMode(probe_mode_);
+
+        // Materialize the columns needed by the selections and later joins
+        for (auto &s : query.selections()) {
+            if (joined.bindings.count(s.binding))
+                join->require(s);
+        }
+        for (unsigned i = 0; i < predicates.size(); ++i) {
+            if (applied[i])
+                continue;
+            if (joined.bindings.count(predicates[i].left.binding))
+                join->require(predicates[i].left);
+            if (joined.bindings.count(predicates[i].right.binding))
+                join->require(predicates[i].right);
+        }
+        executed.emplace_back(joined.bindings, join.get());
+        joined.op = std::move(join);
+        stack.push_back(std::move(joined));
+    }
+
+    PlanInput result;
+    result.bindings = stack.back().bindings;
+    result.op = std::move(stack.back().op);
+    result.op->run();
+    result.mapping = identityBindings(result.bindings);
+    result.correction = stack.back().correction;
+    result.semi_joined = true;
+    return result;
+}
+
+// Find the fact input of a star
+unsigned Joiner::findStar(const QueryInfo &query, const std::vector<PlanInput> &inputs,
+                          const std::vector<bool> &applied) {
+    unsigned num_inputs = inputs.size();
+    if (!estimator_.ready() || num_inputs < STAR_JOIN_MIN_DIMENSIONS + 1)
+        return num_inputs;
+    for (auto &input : inputs) {
+        if (input.op)
+            return num_inputs;
+    }
+    // The predicates between every pair of inputs
+    std::vector<std::vector<unsigned>> joins(num_inputs, std::vector<unsigned>(num_inputs, 0));
+    for (unsigned p = 0; p < query.predicates().size(); ++p) {
+        if (applied[p])
+            continue;
+        for (unsigned i = 0; i < num_inputs; ++i) {
+            for (unsigned j = 0; j < num_inputs; ++j) {
+                if (i != j && connects(query.predicates()[p], inputs[i].bindings, inputs[j].bindings))
+                    ++joins[i][j];
+            }
+        }
+    }
+    for (unsigned fact = 0; fact < num_inputs; ++fact) {
+        double fact_size = estimator_.estimate(query, inputs[fact].bindings);
+        bool star = true;
+        for (unsigned i = 0; i < num_inputs && star; ++i) {
+            if (i == fact)
+                continue;
+            // A single predicate with the fact input and none with the
+            // others; the hash tables are built on the smaller side
+            star = joins[fact][i] == 1
+                && estimator_.estimate(query, inputs[i].bindings) <= fact_size;
+            for (unsigned j = 0; j < num_inputs && star; ++j)
+                star = j == fact || joins[i][j] == 0;
+        }
+        if (star)
+            return fact;
+    }
+    return num_inputs;
+}
+
+// Build and run a star join
+Joiner::PlanInput Joiner::runStar(QueryInfo &query, const std::vector<PlanInput> &inputs,
+                                  unsigned fact, std::vector<bool> &applied,
+                                  const std::vector<KeyLookup> &lookups,
+                                  std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed) {
+    auto &predicates = query.predicates();
+    auto fact_op = openInput(inputs[fact], query, applied, lookups);
+    executed.emplace_back(inputs[fact].bindings, fact_op.get());
+    std::vector<std::unique_ptr<Operator>> dimensions;
+    std::vector<PredicateInfo> join_predicates;
+    PlanInput result;
+    result.bindings = inputs[fact].bindings;
+    for (unsigned i = 0; i < inputs.size(); ++i) {
+        if (i == fact)
+            continue;
+        for (unsigned p = 0; p < predicates.size(); ++p) {
+            if (applied[p] || !connects(predicates[p], inputs[fact].bindings, inputs[i].bindings))
+                continue;
+            applied[p] = true;
+            // Fact column left, dimension column right
+            auto p_info = predicates[p];
+            if (!inputs[fact].bindings.count(p_info.left.binding))
+                std::swap(p_info.left, p_info.right);
+            join_predicates.push_back(p_info);
+        }
+        dimensions.push_back(openInput(inputs[i], query, applied, lookups));
+        executed.emplace_back(inputs[i].bindings, dimensions.back().get());
+        result.bindings.insert(inputs[i].bindings.begin(), inputs[i].bindings.end());
+    }
+
+    auto star = std::make_shared<StarJoin>(move(fact_op), move(dimensions), join_predicates,
+                                           &join_table_cache_);
+    star->setEstimatedSize(estimator_.estimate(query, result.bindings));
+    for (auto &s : query.selections())
+        star->require(s);
+    star->run();
+    executed.emplace_back(result.bindings, star.get());
+    result.op = star;
+    result.mapping = identityBindings(result.bindings);
+    result.semi_joined = true;
+    return result;
+}
+
+// Find the bindings that are only joined for a lookup of a unique key
+std::vector<Joiner::KeyLookup> Joiner::findKeyLookups(const QueryInfo &query,
+                                                      const std::set<unsigned> &covered,
+                                                      std::vector<bool> &applied) {
+    std::vector<KeyLookup> lookups;
+    if (!estimator_.ready())
+        return lookups;
+    auto &predicates = query.predicates();
+    auto &rel_ids = query.relation_ids();
+    std::set<unsigned> looked_up;
+    // Dropping a lookup might turn its partner into a lookup as well
+    for (bool found = true; found;) {
+        found = false;
+        for (unsigned binding = 0; binding < rel_ids.size(); ++binding) {
+            if (covered.count(binding) || looked_up.count(binding)
+                || rel_ids.size() - looked_up.size() < 2)
+                continue;
+            // Neither projected nor the input of an earlier semi-join
+            bool selected = false;
+            for (auto &s : query.selections())
+                selected |= s.binding == binding;
+            for (auto &lookup : lookups)
+                selected |= !lookup.contained && lookup.column.binding == binding;
+            if (selected)
+                continue;
+            // A single remaining predicate with another binding
+            unsigned count = 0, predicate = 0;
+            for (unsigned i = 0; i < predicates.size(); ++i) {
+                if (!applied[i] && (predicates[i].left.binding == binding
+                                    || predicates[i].right.binding == binding)) {
+                    ++count;
+                    predicate = i;
+                }
+            }
+            auto &p = predicates[predicate];
+            if (count != 1 || p.left.binding == p.right.binding)
+                continue;
+            auto &key = p.left.binding == binding ? p.left : p.right;
+            auto &column = p.left.binding == binding ? p.right : p.left;
+            auto &key_stats = statistics_[rel_ids[binding]].columns[key.col_id];
+            if (!key_stats.unique)
+                continue;
+
+            // Filters only on the key, implied by those of the partner column
+            // (as inferred across the predicate)
+            FilterKey key_filters(rel_ids[binding], query.filtersOf(binding));
+            FilterKey column_filters(rel_ids[column.binding], query.filtersOf(column.binding));
+            bool implied = true;
+            for (auto &range : key_filters.ranges()) {
+                ColumnRange column_range(column.col_id);
+                for (auto &other : column_filters.ranges()) {
+                    if (other.col_id == column.col_id)
+                        column_range = other;
+                }
+                implied &= range.col_id == key.col_id && range.contains(column_range);
+            }
+            if (!implied || key_filters.unsatisfiable())
+                continue;
+
+            auto &references = statistics_[rel_ids[column.binding]].columns[column.col_id].references;
+            bool contained = std::find(references.begin(), references.end(),
+                std::make_pair(rel_ids[binding], key.col_id)) != references.end();
+            lookups.push_back(KeyLookup{binding, column, key, contained});
+            looked_up.insert(binding);
+            applied[predicate] = true;
+            found = true;
+        }
+    }
+    return lookups;
+}
+
+// Create the operator reading an input
+std::unique_ptr<Operator> Joiner::openInput(const PlanInput &input, QueryInfo &query,
+                                            std::vector<bool> &applied,
+                                            const std::vector<KeyLookup> &lookups) {
+    std::set<unsigned> used_relations;
+    std::unique_ptr<Operator> root;
+    if (input.op) {
+        root = std::make_unique<SharedResult>(input.op, input.mapping);
+        root->setEstimatedSize(input.op->estimated_size());
+    } else {
+        unsigned binding = *input.bindings.begin();
+        root = addScan(used_relations,
+                       SelectInfo(query.relation_ids()[binding], binding, 0), query);
+    }
+    // Predicates within the input, e.g. between two columns of one relation
+    auto &predicates = query.predicates();
+    for (unsigned i = 0; i < predicates.size(); ++i) {
+        if (applied[i] || !input.bindings.count(predicates[i].left.binding)
+            || !input.bindings.count(predicates[i].right.binding))
+            continue;
+        applied[i] = true;
+        double estimated_size = root->estimated_size();
+        auto p_info = predicates[i];
+        root = std::make_unique<SelfJoin>(move(root), p_info);
+        root->setEstimatedSize(estimated_size);
+    }
+    for (auto &lookup : lookups) {
+        if (input.semi_joined || lookup.contained
+            || !input.bindings.count(lookup.column.binding))
+            continue;
+        // The fraction of the column finding a key
+        double estimated_size = root->estimated_size();
+        double column_size = estimator_.estimate(query, {lookup.column.binding});
+        if (column_size > 0)
+            estimated_size *= estimator_.estimate(query, {lookup.column.binding, lookup.binding})
+                / column_size;
+        root = std::make_unique<SemiJoin>(move(root), lookup.column,
+                                          getRelation(lookup.key.rel_id), lookup.key,
+                                          &join_table_cache_);
+        root->setEstimatedSize(estimated_size);
+    }
+    return root;
+}
+
+// Record the actual sizes of the executed sub-plans of a query
+void Joiner::recordFeedback(const QueryInfo &query,
+                            const std::vector<std::pair<std::set<unsigned>, const Operator *>> &executed) {
+    for (auto &sub_plan : executed) {
+        feedback_.record(CardinalityFeedback::signature(query, sub_plan.first),
+                         estimator_.estimateWithoutFeedback(query, sub_plan.first),
+                         sub_plan.second->result_size());
+    }
+}
+
+// Executes a join query, starting from a shared sub-plan
+std::string Joiner::join(QueryInfo &query, const SharedInput *shared) {
+    // The buffers of the query are released at once when it is done
+    ArenaScope arena_scope(use_arena_ ? &arena_ : nullptr);
+    estimator_.startQuery(query);
+    auto &predicates = query.predicates();
+    std::vector<bool> applied(predicates.size(), false);
+
+    // Every binding is an input of its own, except for those covered by the
+    // sub-plan that was run once for the whole batch
+    std::vector<PlanInput> inputs;
+    std::set<unsigned> covered;
+    if (shared) {
+        PlanInput input;
+        for (auto &binding : shared->bindings)
+            input.bindings.insert(binding.first);
+        input.op = shared->op;
+        input.mapping = shared->bindings;
+        if (estimator_.ready())
+            input.correction = std::max(1.0, 1.0 * shared->op->result_size())
+                / std::max(1.0, estimator_.estimate(query, input.bindings));
+        covered = input.bindings;
+        applied[shared->predicate] = true;
+        inputs.push_back(std::move(input));
+    }
+    // Relations only joined for a key lookup are dropped (or semi-joined)
+    auto lookups = findKeyLookups(query, covered, applied);
+    std::set<unsigned> looked_up, semi_joined;
+    for (auto &lookup : lookups) {
+        looked_up.insert(lookup.binding);
+        if (!lookup.contained)
+            semi_joined.insert(lookup.column.binding);
+    }
+    for (unsigned binding = 0; binding < query.relation_ids().size(); ++binding) {
+        if (!covered.count(binding) && !looked_up.count(binding)) {
+            PlanInput input;
+            input.bindings.insert(binding);
+            inputs.push_back(std::move(input));
+        }
+    }
+
+    // Run the plan one join at a time. If the size of an intermediate result
+    // is far off its estimate, the remaining joins are planned again with the
+    // intermediate result as an input. Star joins and bushy plans (in postfix
+    // form) are run at once
+    std::vector<unsigned> plan, tree;
+    unsigned fact = inputs.size();
+    if (!shared && estimator_.ready()) {
+        // Reuse the plan of an earlier query of the same template unless
+        // the constants change the scan estimates too much
+        auto key = PlanCache::key(query);
+        std::vector<double> scan_estimates;
+        for (unsigned binding = 0; binding < query.relation_ids().size(); ++binding)
+            scan_estimates.push_back(estimator_.estimateScan(query, binding));
+        // Cached plans list the (first) binding of every input
+        std::vector<unsigned> order;
+        std::map<unsigned, unsigned> input_of;
+        for (unsigned i = 0; i < inputs.size(); ++i)
+            input_of[*inputs[i].bindings.begin()] = i;
+        if (plan_cache_.lookup(key, scan_estimates, order)) {
+            if (order.size() == 2 && order[1] == PLAN_STAR) {
+                // Key lookups depend on the constants: check the shape
+                if (input_of.count(order[0])
+                    && findStar(query, inputs, applied) == input_of[order[0]])
+                    fact = input_of[order[0]];
+            } else {
+                for (auto binding : order) {
+                    if (binding == PLAN_JOIN) {
+                        tree.push_back(PLAN_JOIN);
+                    } else if (input_of.count(binding)) {
+                        plan.push_back(input_of[binding]);
+                        tree.push_back(input_of[binding]);
+                    }
+                }
+                if (plan.size() == tree.size())
+                    tree.clear();
+                // Dropping the leaves of eliminated bindings leaves their
+                // joins behind: such a tree is planned again
+                if (!tree.empty() && tree.size() - plan.size() + 1 != plan.size()) {
+                    tree.clear();
+                    plan.clear();
+                }
+            }
+        }
+        if (fact == inputs.size() && plan.size() != inputs.size()) {
+            fact = findStar(query, inputs, applied);
+            tree.clear();
+            plan.clear();
+            order.clear();
+            if (fact < inputs.size()) {
+                order = {*inputs[fact].bindings.begin(), PLAN_STAR};
+            } else {
+                tree = planBushy(query, inputs);
+                if (tree.empty())
+                    plan = planJoinOrder(query, inputs);
+                for (auto id : tree.empty() ? plan : tree)
+                    order.push_back(id == PLAN_JOIN ? PLAN_JOIN : *inputs[id].bindings.begin());
+            }
+            plan_cache_.insert(key, CachedPlan{order, move(scan_estimates)});
+        }
+    } else {
+        fact = findStar(query, inputs, applied);
+        if (fact == inputs.size())
+            tree = planBushy(query, inputs);
+        if (fact == inputs.size() && tree.empty())
+            plan = planJoinOrder(query, inputs);
+    }
+    // The executed scans and joins (for the cardinality feedback)
+    std::vector<std::pair<std::set<unsigned>, const Operator *>> executed;
+    if (fact < inputs.size()) {
+        // Stream the fact input through all dimensions at once
+        auto result = runStar(query, inputs, fact, applied, lookups, executed);
+        inputs.clear();
+        inputs.push_back(std::move(result));
+        plan = {0};
+    }
+    if (!tree.empty()) {
+        auto result = runBushy(query, inputs, tree, applied, lookups, executed);
+        inputs.clear();
+        inputs.push_back(std::move(result));
+        plan = {0};
+    }
+    std::set<unsigned> used_relations = inputs[plan[0]].bindings;
+    double correction = inputs[plan[0]].correction;
+    auto root = openInput(inputs[plan[0]], query, applied, lookups);
+    if (!inputs[plan[0]].op)
+        executed.emplace_back(inputs[plan[0]].bindings, root.get());
+    for (unsigned step = 1; step < plan.size(); ++step) {
+        auto &input = inputs[plan[step]];
+        std::vector<PredicateInfo> join_predicates;
+        for (unsigned i = 0; i < predicates.size(); ++i) {
+            if (!applied[i] && connects(predicates[i], used_relations, input.bindings)) {
+                applied[i] = true;
+                join_predicates.push_back(predicates[i]);
+            }
+        }
+        auto right = openInput(input, query, applied, lookups);
+        if (!input.op)
+            executed.emplace_back(input.bindings, right.get());
+        used_relations.insert(input.bindings.begin(), input.bindings.end());
+        correction *= input.correction;
+        auto join = std::make_shared<Join>(move(root), move(right), join_predicates,
+                                           &join_table_cache_);
+        join->setProbeMode(probe_mode_);
+        double estimate = estimator_.ready() ? estimator_.estimate(query, used_relations) : -1;
+        if (estimator_.ready())
+            join->setEstimatedSize(estimate * correction);
+
+        // Materialize the columns needed by the selections and later joins
+        for (auto &s : query.selections()) {
+            if (used_relations.count(s.binding))
+                join->require(s);
+        }
+        for (unsigned i = 0; i < predicates.size(); ++i) {
+            if (applied[i])
+                continue;
+            if (used_relations.count(predicates[i].left.binding))
+                join->require(predicates[i].left);
+            if (used_relations.count(predicates[i].right.binding))
+                join->require(predicates[i].right);
+        }
+        join->run();
+        executed.emplace_back(used_relations, join.get());
+
+        // Joining an empty result stays empty: skip the remaining inputs
+        if (join->result_size() == 0) {
+            root = std::make_unique<SharedResult>(join, identityBindings(used_relations));
+            root->setEstimatedSize(join->estimated_size());
+            break;
+        }
+
+        double actual = std::max(1.0, 1.0 * join->result_size());
+        double expected = std::max(1.0, estimate * correction);
+        bool replan = estimator_.ready() && plan.size() - step > 2
+            && std::max(actual / expected, expected / actual) > replan_factor_;
+        if (replan) {
+            if (explain_)
+                std::cerr << "REPLAN after " << join->describe() << " (estimated: "
+                          << expected << ", actual: " << join->result_size() << ")"
+                          << std::endl;
+            PlanInput intermediate;
+            intermediate.bindings = used_relations;
+            intermediate.op = join;
+            intermediate.mapping = identityBindings(used_relations);
+            intermediate.correction = actual / std::max(1.0, estimate);
+            intermediate.semi_joined = true;
+            std::vector<PlanInput> remaining;
+            remaining.push_back(std::move(intermediate));
+            for (unsigned k = step + 1; k < plan.size(); ++k)
+                remaining.push_back(std::move(inputs[plan[k]]));
+            inputs = std::move(remaining);
+            plan = planJoinOrder(query, inputs);
+            used_relations = inputs[plan[0]].bindings;
+            correction = inputs[plan[0]].correction;
+            root = openInput(inputs[plan[0]], query, applied, lookups);
+            if (!inputs[plan[0]].op)
+                executed.emplace_back(inputs[plan[0]].bindings, root.get());
+            step = 0;
+            continue;
+        }
+        root = std::make_unique<SharedResult>(join, identityBindings(used_relations));
+        root->setEstimatedSize(join->estimated_size());
     }
 
     Checksum checksum(move(root), query.selections());
+    if (estimator_.ready())
+        checksum.setEstimatedSize(estimator_.estimate(query, used_relations) * correction);
     checksum.run();
+    if (estimator_.ready()) {
+        // Skipped inputs have no actual size and signatures do not cover
+        // semi-joins
+        executed.erase(std::remove_if(executed.begin(), executed.end(), [&](auto &sub_plan) {
+            if (sub_plan.second->skipped())
+                return true;
+            for (auto binding : semi_joined) {
+                if (sub_plan.first.count(binding))
+                    return true;
+            }
+            return false;
+        }), executed.end());
+        recordFeedback(query, executed);
+    }
+
+    if (explain_) {
+        std::cerr << "EXPLAIN " << query.dumpText() << std::endl;
+        checksum.explain(std::cerr, 1);
+    }
 
     std::stringstream out;
     auto &results = checksum.check_sums();
@@ -127,3 +861,104 @@ std::string Joiner::join(QueryInfo &query) {
     return out.str();
 }
 
+
+// Executes a batch of join queries. Join predicates whose inputs (relation,
+// filters and join column on both sides) recur in several queries of the
+// batch are joined once; every consuming query then starts its plan from
+// the shared result. Shared base scans are run once through the scan cache.
+std::vector<std::string> Joiner::joinBatch(std::vector<QueryInfo> &queries) {
+    // The shared sub-plans live until the whole batch is done
+    ArenaScope arena_scope(use_arena_ ? &arena_ : nullptr);
+    // Signatures of the join predicates of every query
+    struct Consumer {
+        unsigned query;
+        unsigned predicate;
+        /// The predicate sides are in canonical (signature) order
+        bool swapped;
+    };
+    std::map<std::string, std::vector<Consumer>> edges;
+    std::vector<bool> satisfiable(queries.size());
+    for (unsigned q = 0; q < queries.size(); ++q) {
+        satisfiable[q] = queries[q].inferFilters() && !estimator_.provesEmpty(queries[q]);
+        if (!satisfiable[q])
+            continue;
+        auto &predicates = queries[q].predicates();
+        std::set<std::string> seen;
+        for (unsigned p = 0; p < predicates.size(); ++p) {
+            if (predicates[p].left.binding == predicates[p].right.binding)
+                continue;
+            auto left = sideSignature(predicates[p].left, queries[q]);
+            auto right = sideSignature(predicates[p].right, queries[q]);
+            bool swapped = right < left;
+            auto signature = swapped ? right + "=" + left : left + "=" + right;
+            if (seen.insert(signature).second)
+                edges[signature].push_back(Consumer{q, p, swapped});
+        }
+    }
+
+    // Greedily share the predicates with the most consumers; every query
+    // starts from at most one shared result
+    std::vector<const std::vector<Consumer> *> candidates;
+    for (auto &edge : edges) {
+        if (edge.second.size() > 1)
+            candidates.push_back(&edge.second);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [](auto *a, auto *b) { return a->size() > b->size(); });
+
+    std::vector<std::unique_ptr<SharedInput>> shared(queries.size());
+    for (auto *consumers : candidates) {
+        std::vector<Consumer> open;
+        for (auto &c : *consumers) {
+            if (!shared[c.query])
+                open.push_back(c);
+        }
+        if (open.size() < 2)
+            continue;
+
+        // The producer uses the bindings of the first consumer
+        auto &first_query = queries[open[0].query];
+        auto first_pred = first_query.predicates()[open[0].predicate];
+        if (open[0].swapped)
+            std::swap(first_pred.left, first_pred.right);
+        std::set<unsigned> used_relations;
+        estimator_.startQuery(first_query);
+        auto join = std::make_shared<Join>(
+            addScan(used_relations, first_pred.left, first_query),
+            addScan(used_relations, first_pred.right, first_query),
+            first_pred, &join_table_cache_);
+        join->setProbeMode(probe_mode_);
+        std::shared_ptr<Operator> producer = join;
+        if (estimator_.ready())
+            producer->setEstimatedSize(estimator_.estimate(first_query, used_relations));
+
+        for (auto &c : open) {
+            auto &query = queries[c.query];
+            auto pred = query.predicates()[c.predicate];
+            if (c.swapped)
+                std::swap(pred.left, pred.right);
+            auto input = std::make_unique<SharedInput>();
+            input->op = producer;
+            input->bindings[pred.left.binding] = first_pred.left.binding;
+            input->bindings[pred.right.binding] = first_pred.right.binding;
+            input->predicate = c.predicate;
+            // Materialize every column the consumer needs from both sides
+            for (auto &binding : input->bindings) {
+                for (auto col_id : collectColumns(query, binding.first)) {
+                    SelectInfo info(query.relation_ids()[binding.first],
+                                    binding.second, col_id);
+                    producer->require(info);
+                }
+            }
+            shared[c.query] = std::move(input);
+        }
+        producer->run();
+    }
+
+    std::vector<std::string> results;
+    for (unsigned q = 0; q < queries.size(); ++q) {
+        results.emplace_back(satisfiable[q] ? join(queries[q], shared[q].get())
+                                            : nullResult(queries[q]));
+    }
+    return results;
+}
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+
+#include "relation.h"
+
+// Converts relation files between the binary formats (version 2 by default)
+int main(int argc, char *argv[]) {
+    RelationFormat format = RelationFormat::V2;
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]) == "--v1") {
+        format = RelationFormat::V1;
+        first = 2;
+    }
+    if (argc - first != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--v1] <input relation> <output relation>"
+                  << std::endl;
+        return 1;
+    }
+
+    // The input stays mapped while the output is written
+    if (std::string(argv[first]) == argv[first + 1]) {
+        std::cerr << "The output must not overwrite the input" << std::endl;
+        return 1;
+    }
+
+    // Version 1 and version 2 inputs are both read
+    Relation relation(argv[first], LoadMode::Lazy);
+    relation.storeRelation(argv[first + 1], format);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <malloc.h>
 
 #include "joiner.h"
 #include "parser.h"
@@ -10,34 +11,82 @@ double * total_time = get_total_time();
 
 int main(int argc, char *argv[]) {
     Joiner joiner;
+    // --explain: print every plan with estimated and actual sizes to stderr
+    // --replan-factor <f>: re-plan a query if an intermediate result is f
+    //                      times larger or smaller than estimated
+    // --simple-probe: probe unique-key hash tables one key after the other
+    //                 (no group prefetching)
+    // --no-arena: allocate intermediate buffers on the heap
+    // --lazy-load: map relation files without populating them
+    // --copy-relations: copy relation files into huge pages
+    // --snapshots: map statistics and indexes from snapshots next to the
+    //              relation files (written by the first run)
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--explain")
+            joiner.setExplain(true);
+        else if (std::string(argv[i]) == "--replan-factor" && i + 1 < argc)
+            joiner.setReplanFactor(std::stod(argv[++i]));
+        else if (std::string(argv[i]) == "--simple-probe")
+            joiner.setProbeMode(ProbeMode::Simple);
+        else if (std::string(argv[i]) == "--no-arena")
+            joiner.setUseArena(false);
+        else if (std::string(argv[i]) == "--lazy-load")
+            joiner.setLoadMode(LoadMode::Lazy);
+        else if (std::string(argv[i]) == "--copy-relations")
+            joiner.setLoadMode(LoadMode::Copy);
+        else if (std::string(argv[i]) == "--snapshots")
+            joiner.setUseSnapshots(true);
+    }
+
+    // Keep freed heap buffers (hash tables, results) mapped for later
+    // queries instead of returning them to the system (and faulting them in
+    // again): serve allocations up to the maximum threshold from the heap and
+    // trim it only beyond 1 GB of free memory
+    mallopt(M_MMAP_THRESHOLD, 32 << 20);
+    mallopt(M_TRIM_THRESHOLD, 1 << 30);
 
     // Read join relations
     std::string line;
+    std::vector<std::string> file_names;
     while (getline(std::cin, line)) {
         if (line == "Done") break;
-        joiner.addRelation(line.c_str());
+        file_names.push_back(line);
     }
+    joiner.addRelations(file_names);
 
     // Preparation phase (not timed)
-    // Build histograms, indexes,...
-    // TOOD: iterate over all relations and columns in joiner, and build maps for them
-    // TODO: iterate over all relations and columns in joiner, and build histograms for them
-    for (const Relation &relation : joiner.relations()) {
+    // Build histograms, samples and indexes
+    joiner.buildStatistics();
 
-    }
+    long prepared_minor, prepared_major;
+    get_page_faults(&prepared_minor, &prepared_major);
 
     reset_time();
     double start = omp_get_wtime();
 
-    QueryInfo i;
+    std::vector<QueryInfo> batch;
     while (getline(std::cin, line)) {
-        if (line == "F") continue; // End of a batch
-        i.parseQuery(line);
-        std::cout << joiner.join(i);
+        if (line == "F") { // End of a batch
+            for (auto &result : joiner.joinBatch(batch))
+                std::cout << result;
+            batch.clear();
+            continue;
+        }
+        batch.emplace_back(line);
     }
 
     *total_time = (omp_get_wtime() - start);
+    long minor, major;
+    get_page_faults(&minor, &major);
     display_time();
+    std::cerr << "Page faults: " << prepared_minor << " minor, " << prepared_major
+              << " major during preparation, " << minor - prepared_minor << " minor, "
+              << major - prepared_major << " major during queries" << std::endl;
+    joiner.scan_cache().report(std::cerr);
+    joiner.join_table_cache().report(std::cerr);
+    joiner.plan_cache().report(std::cerr);
+    joiner.feedback().report(std::cerr);
+    joiner.arena().report(std::cerr);
 
     return 0;
 }
@@ -2,17 +2,28 @@
 #include <omp.h>
 #include <set>
 #include <utility>
+#include "gather.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
+#include <type_traits>
 
 #define NUM_THREADS 48
 #define DEPTH_WORTHY_PARALLELIZATION 1
-#define RESERVE_FACTOR 2
+// Probe tuples per morsel of a join: matches are counted per morsel first
+#define PROBE_MORSEL_SIZE 16384
+// Tuples sampled to order the filter ranges of a scan
+#define FILTER_SAMPLE_SIZE 1024
+// Range selectivities between these bounds are evaluated without branches
+#define FILTER_PREDICATION_LOW 0.05
+#define FILTER_PREDICATION_HIGH 0.95
 
 using namespace::std;
 
+// The timers (updated atomically: subtrees of bushy plans run concurrently)
 double *join_prep_time = get_join_prep_time(),
        *join_build_time = get_join_build_time(),
        *join_probing_time = get_join_probing_time(),
@@ -21,6 +32,8 @@ double *join_prep_time = get_join_prep_time(),
        *self_join_probing_time = get_self_join_probing_time(),
        *self_join_materialization_time = get_self_join_materialization_time(),
        *check_sum_time = get_checksum_time(),
+       *semi_join_time = get_semi_join_time(),
+       *star_join_time = get_star_join_time(),
        *filter_time = get_filter_time();
 
 // Get materialized results
@@ -33,9 +46,8 @@ std::vector<uint64_t *> Operator::getResults() {
         }
     else {
         size_t num_cols_per_thread = (num_cols / NUM_THREADS) + (num_cols % NUM_THREADS);
-        #pragma omp parallel num_threads(NUM_THREADS)
-        {
-            size_t tid = omp_get_thread_num();
+        #pragma omp parallel for num_threads(NUM_THREADS)
+        for (size_t tid = 0; tid < NUM_THREADS; ++tid) {
             size_t start_ind = num_cols_per_thread * tid;
             size_t end_ind = start_ind + num_cols_per_thread;
             if (end_ind > num_cols) end_ind = num_cols;
@@ -46,6 +58,34 @@ std::vector<uint64_t *> Operator::getResults() {
     return result_vector;
 }
 
+// Print the operator tree with estimated and actual result sizes
+void Operator::explain(std::ostream &out, unsigned depth, bool skipped) const {
+    out << std::string(2 * depth, ' ') << describe() << "  (estimated: ";
+    if (estimated_size_ < 0) {
+        out << "?";
+    } else {
+        out << static_cast<uint64_t>(std::round(estimated_size_));
+    }
+    // The inputs of a skipped operator have not been run either
+    skipped |= skipped_;
+    if (skipped) {
+        out << ", skipped)" << std::endl;
+        for (auto *child : children())
+            child->explain(out, depth + 1, true);
+        return;
+    }
+    out << ", actual: " << result_size_;
+    if (estimated_size_ >= 0) {
+        // q-error: factor by which the estimate is off
+        double estimate = std::max(estimated_size_, 1.0);
+        double actual = std::max(static_cast<double>(result_size_), 1.0);
+        out << ", q-error: " << std::max(estimate / actual, actual / estimate);
+    }
+    out << ")" << std::endl;
+    for (auto *child : children())
+        child->explain(out, depth + 1);
+}
+
 // Require a column and add it to results
 bool Scan::require(SelectInfo info) {
     if (info.binding != relation_binding_)
@@ -67,6 +107,11 @@ std::vector<uint64_t *> Scan::getResults() {
     return result_columns_;
 }
 
+// Describe the operator
+std::string Scan::describe() const {
+    return "Scan " + std::to_string(relation_binding_);
+}
+
 // Require a column and add it to results
 bool FilterScan::require(SelectInfo info) {
     if (info.binding != relation_binding_)
@@ -82,101 +127,220 @@ bool FilterScan::require(SelectInfo info) {
     return true;
 }
 
-// Apply filter
-bool FilterScan::applyFilter(uint64_t i, FilterInfo &f) {
-    auto compare_col = relation_.columns()[f.filter_column.col_id];
-    auto constant = f.constant;
-    switch (f.comparison) {
-        case FilterInfo::Comparison::Equal:return compare_col[i] == constant;
-        case FilterInfo::Comparison::Greater:return compare_col[i] > constant;
-        case FilterInfo::Comparison::Less:return compare_col[i] < constant;
-    };
-    return false;
+// Order the ranges of the filters by their selectivity on a sample
+template <typename RowId>
+void FilterScan::orderRanges(const FilterKey &key, const vector<RowId> *candidates) {
+    ranges_ = key.ranges();
+    size_t input_data_size = candidates ? candidates->size() : relation_.size();
+    uint64_t stride = max<uint64_t>(1, input_data_size / FILTER_SAMPLE_SIZE);
+    vector<uint64_t> passed(ranges_.size(), 0);
+    uint64_t sampled = 0;
+    for (uint64_t i = 0; i < input_data_size; i += stride, ++sampled) {
+        uint64_t id = candidates ? (*candidates)[i] : i;
+        for (size_t r = 0; r < ranges_.size(); ++r)
+            passed[r] += ranges_[r].contains(relation_.columns()[ranges_[r].col_id][id]);
+    }
+    vector<size_t> order(ranges_.size());
+    for (size_t r = 0; r < order.size(); ++r)
+        order[r] = r;
+    stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return passed[a] < passed[b]; });
+    vector<ColumnRange> ordered;
+    for (auto r : order)
+        ordered.push_back(ranges_[r]);
+    ranges_ = move(ordered);
+
+    // Branches on the most selective range are predictable if almost all
+    // tuples fail it or almost all tuples pass every range
+    double selectivity = sampled ? 1.0 * passed[order[0]] / sampled : 0.0;
+    predicated_ = selectivity > FILTER_PREDICATION_LOW && selectivity < FILTER_PREDICATION_HIGH;
 }
 
-// Run
-void FilterScan::run() {
-    double begin_time = omp_get_wtime(), end_time;
-
-    size_t input_data_size = relation_.size();
-    size_t num_cols = input_data_.size();
-
-    
-
-
+// Select the qualifying tuple ids (among the candidates, if given)
+template <typename RowId>
+vector<RowId> FilterScan::select(const vector<RowId> *candidates) {
+    size_t input_data_size = candidates ? candidates->size() : relation_.size();
 
     uint64_t size_per_thread;
     uint64_t num_threads;
-    if (input_data_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION) {
+    if (input_data_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION)
         num_threads = 1;
-        size_per_thread = input_data_size;
-    } else
+    else
         num_threads = NUM_THREADS;
     size_per_thread = (input_data_size / num_threads) + (input_data_size % num_threads != 0);
-    vector<vector<size_t>> thread_selected_ids(num_threads);
-    vector<size_t> thread_result_sizes = vector<size_t> (num_threads, 0);
+    vector<ArenaVector<RowId>> thread_selected_ids(num_threads);
+
+    // A range check is a single comparison: v - low <= high - low
+    size_t num_ranges = ranges_.size();
+    vector<const uint64_t *> columns;
+    vector<uint64_t> lows, widths;
+    for (auto &range : ranges_) {
+        columns.push_back(relation_.columns()[range.col_id]);
+        lows.push_back(range.low);
+        widths.push_back(range.high - range.low);
+    }
 
-    #pragma omp parallel num_threads(num_threads)
-    {
-        uint64_t tid = omp_get_thread_num();
-        thread_selected_ids[tid] = vector<size_t> ();
-        thread_selected_ids[tid].reserve(size_per_thread);
+    #pragma omp parallel for num_threads(num_threads)
+    for (uint64_t tid = 0; tid < num_threads; ++tid) {
+        auto &selected = thread_selected_ids[tid];
 
         uint64_t start_ind = tid * size_per_thread;
         uint64_t end_ind = start_ind + size_per_thread;
         if (end_ind > input_data_size) end_ind = input_data_size;
 
-        uint64_t size = 0;
-        bool pass;
-
-        for (uint64_t i = start_ind; i < end_ind; ++i) {
-            pass = true;
-            for (auto &f : filters_) {
-            pass &= applyFilter(i, f);
-                if (!pass) break;
+        if (start_ind >= end_ind) {
+            // Nothing to select
+        } else if (predicated_) {
+            // Write every id and only advance past the qualifying ones
+            selected.resize(end_ind - start_ind);
+            RowId *out = selected.data();
+            size_t count = 0;
+            for (uint64_t i = start_ind; i < end_ind; ++i) {
+                uint64_t id = candidates ? (*candidates)[i] : i;
+                bool pass = true;
+                for (size_t r = 0; r < num_ranges; ++r)
+                    pass &= columns[r][id] - lows[r] <= widths[r];
+                out[count] = id;
+                count += pass;
             }
-            if (pass) {
-                thread_selected_ids[tid][size] = i;
-                ++size;
+            selected.resize(count);
+        } else {
+            selected.reserve(end_ind - start_ind);
+            for (uint64_t i = start_ind; i < end_ind; ++i) {
+                uint64_t id = candidates ? (*candidates)[i] : i;
+                bool pass = true;
+                for (size_t r = 0; r < num_ranges && pass; ++r)
+                    pass = columns[r][id] - lows[r] <= widths[r];
+                if (pass)
+                    selected.push_back(id);
             }
         }
-        thread_result_sizes[tid] = size;
     }
 
     // Reduction
     vector<size_t> thread_cum_sizes = vector<size_t> (num_threads + 1, 0);
-    result_size_ = 0;
-    for (uint64_t t = 0; t < num_threads; ++t) {
-        thread_cum_sizes[t+1] = thread_cum_sizes[t] + thread_result_sizes[t];
-        result_size_ += thread_result_sizes[t];
+    for (uint64_t t = 0; t < num_threads; ++t)
+        thread_cum_sizes[t+1] = thread_cum_sizes[t] + thread_selected_ids[t].size();
+
+    vector<RowId> selected(thread_cum_sizes[num_threads]);
+    #pragma omp parallel for num_threads(num_threads)
+    for (uint64_t tid = 0; tid < num_threads; ++tid) {
+        copy(thread_selected_ids[tid].begin(), thread_selected_ids[tid].end(),
+            selected.begin() + thread_cum_sizes[tid]);
     }
+    return selected;
+}
 
-    // Materialization
-    for (size_t c = 0; c < num_cols; ++c) {
-        tmp_results_[c].reserve(result_size_);
+// The qualifying tuple ids
+template <typename RowId>
+shared_ptr<const vector<RowId>> FilterScan::selection(const FilterKey &key) {
+    if (key.unsatisfiable())
+        return make_shared<const vector<RowId>>();
+    if constexpr (is_same<RowId, uint32_t>::value) {
+        // Reuse the selection of an earlier scan with the same (or weaker) filters
+        bool exact = false;
+        Selection candidates = cache_ ? cache_->lookup(key, exact) : nullptr;
+        if (exact)
+            return candidates;
+        orderRanges(key, candidates.get());
+        Selection selected = make_shared<const vector<RowId>>(select(candidates.get()));
+        if (cache_)
+            cache_->insert(key, selected);
+        return selected;
+    } else {
+        orderRanges<RowId>(key, nullptr);
+        return make_shared<const vector<RowId>>(select<RowId>(nullptr));
     }
+}
 
-    #pragma omp parallel num_threads(num_threads)
-    {
-        uint64_t tid = omp_get_thread_num();
+// Run
+void FilterScan::run() {
+    double begin_time = omp_get_wtime(), end_time;
+
+    size_t num_cols = input_data_.size();
+    FilterKey key(filters_[0].filter_column.rel_id, filters_);
+    dispatchRowId(relation_.size(), [&](auto row_id) {
+        using RowId = decltype(row_id);
+        auto selected = selection<RowId>(key);
+        result_size_ = selected->size();
 
-        vector<size_t> &selected = thread_selected_ids[tid];
-        size_t t_size = thread_result_sizes[tid];
-        size_t cur_ind = thread_cum_sizes[tid];
+        // Materialization
+        for (size_t c = 0; c < num_cols; ++c) {
+            tmp_results_[c].resize(result_size_);
+        }
 
-        for (uint64_t i = 0; i < t_size; ++i) {
-            size_t id = selected[i];
-            for (unsigned cId = 0; cId < num_cols; ++cId) {
-                tmp_results_[cId][cur_ind] = input_data_[cId][id];
+        uint64_t num_threads = result_size_ < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
+        uint64_t size_per_thread = (result_size_ / num_threads) + (result_size_ % num_threads != 0);
+        const RowId *ids = selected->data();
+
+        #pragma omp parallel for num_threads(num_threads)
+        for (uint64_t tid = 0; tid < num_threads; ++tid) {
+            uint64_t start_ind = tid * size_per_thread;
+            uint64_t end_ind = start_ind + size_per_thread;
+            if (end_ind > result_size_) end_ind = result_size_;
+
+            for (uint64_t i = start_ind; i < end_ind; ++i) {
+                uint64_t id = ids[i];
+                for (unsigned cId = 0; cId < num_cols; ++cId) {
+                    tmp_results_[cId][i] = input_data_[cId][id];
+                }
             }
-            cur_ind++;
         }
-    }
+    });
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *filter_time += (end_time - begin_time);
 }
 
+// Require a column and add it to results
+bool SharedResult::require(SelectInfo info) {
+    auto iter = bindings_.find(info.binding);
+    if (iter == bindings_.end())
+        return false;
+    if (select_to_result_col_id_.find(info) == select_to_result_col_id_.end()) {
+        SelectInfo producer_info(info.rel_id, iter->second, info.col_id);
+        result_columns_.push_back(input_data_[input_->resolve(producer_info)]);
+        select_to_result_col_id_[info] = result_columns_.size() - 1;
+    }
+    return true;
+}
+
+// Run
+void SharedResult::run() {
+    // The producer has already been run
+    result_size_ = input_->result_size();
+}
+
+// Whether no value of a result column occurs twice
+bool SharedResult::isUnique(const SelectInfo &info) const {
+    auto iter = bindings_.find(info.binding);
+    return iter != bindings_.end()
+        && input_->isUnique(SelectInfo(info.rel_id, iter->second, info.col_id));
+}
+
+// Describe the operator
+std::string SharedResult::describe() const {
+    return "SharedResult";
+}
+
+// Describe the operator
+std::string FilterScan::describe() const {
+    std::string out = "FilterScan " + std::to_string(relation_binding_) + " [";
+    for (size_t i = 0; i < filters_.size(); ++i) {
+        out += FilterInfo(filters_[i]).dumpText();
+        if (i < filters_.size() - 1)
+            out += FilterInfo::delimiter;
+    }
+    return out + "]";
+}
+
+// A filtered base relation
+bool FilterScan::baseFingerprint(std::string &fingerprint) const {
+    fingerprint = FilterKey(filters_[0].filter_column.rel_id, filters_).str();
+    return true;
+}
+
 // Require a column and add it to results
 bool Join::require(SelectInfo info) {
     if (requested_columns_.count(info) == 0) {
@@ -197,12 +361,24 @@ bool Join::require(SelectInfo info) {
     return true;
 }
 
+// Describe the operator
+std::string Join::describe() const {
+    std::string out = "Join ";
+    for (size_t i = 0; i < p_infos_.size(); ++i) {
+        out += PredicateInfo(p_infos_[i]).dumpText();
+        if (i < p_infos_.size() - 1)
+            out += PredicateInfo::delimiter;
+    }
+    return out;
+}
+
 // Swap
 void Join::swap() {
     // Use smaller input_ for build
     if (left_->result_size() > right_->result_size()) {
         std::swap(left_, right_);
-        std::swap(p_info_.left, p_info_.right);
+        for (auto &p_info : p_infos_)
+            std::swap(p_info.left, p_info.right);
         std::swap(requested_columns_left_, requested_columns_right_);
     }
 }
@@ -210,10 +386,43 @@ void Join::swap() {
 // Run
 void Join::run() {
 
-    left_->require(p_info_.left);
-    right_->require(p_info_.right);
-    left_->run();
-    right_->run();
+    // Orient the predicates: the left sides are provided by the left input
+    for (auto &p_info : p_infos_) {
+        if (!left_->require(p_info.left)) {
+            std::swap(p_info.left, p_info.right);
+            left_->require(p_info.left);
+        }
+        right_->require(p_info.right);
+    }
+    if (parallel_inputs_) {
+        // Each input gets a team of threads of its own
+        if (omp_get_level() == 0 && omp_get_max_active_levels() < 2)
+            omp_set_max_active_levels(2);
+        #pragma omp parallel sections num_threads(2)
+        {
+            #pragma omp section
+            left_->run();
+            #pragma omp section
+            right_->run();
+        }
+    } else {
+        // An empty input makes the other one (and the build and probe) needless
+        left_->run();
+        if (left_->result_size() == 0) {
+            right_->skip();
+        } else {
+            right_->run();
+        }
+    }
+    if (left_->result_size() == 0 || right_->result_size() == 0) {
+        result_size_ = 0;
+        unsigned res_col_id = 0;
+        for (auto &info : requested_columns_left_)
+            select_to_result_col_id_[info] = res_col_id++;
+        for (auto &info : requested_columns_right_)
+            select_to_result_col_id_[info] = res_col_id++;
+        return;
+    }
 
     // Preparation phase
     double begin_time = omp_get_wtime(), end_time;
@@ -233,8 +442,16 @@ void Join::run() {
         select_to_result_col_id_[info] = res_col_id++;
     }
 
-    auto left_col_id = left_->resolve(p_info_.left);
-    auto right_col_id = right_->resolve(p_info_.right);
+    auto left_col_id = left_->resolve(p_infos_[0].left);
+    auto right_col_id = right_->resolve(p_infos_[0].right);
+
+    // The columns of the remaining predicates
+    vector<uint64_t *> left_residual_cols, right_residual_cols;
+    for (size_t p = 1; p < p_infos_.size(); ++p) {
+        left_residual_cols.push_back(left_input_data[left_->resolve(p_infos_[p].left)]);
+        right_residual_cols.push_back(right_input_data[right_->resolve(p_infos_[p].right)]);
+    }
+    size_t num_residuals = left_residual_cols.size();
 
     uint64_t left_input_size = left_->result_size();
     auto left_key_column = left_input_data[left_col_id];
@@ -244,120 +461,231 @@ void Join::run() {
     auto right_key_column = right_input_data[right_col_id];
     uint64_t right_input_size = right_->result_size();
 
-    uint64_t right_size_per_thread;
-    uint64_t num_threads;
-    if (right_input_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION) {
-        num_threads = 1;
-        right_size_per_thread = right_input_size;
-    } else {
-        num_threads = NUM_THREADS;
-        right_size_per_thread = (right_input_size / num_threads) + (right_input_size % num_threads != 0);
-    }
-    uint64_t left_size_per_thread = (left_input_size / num_threads) + (left_input_size % num_threads != 0);
+    uint64_t num_threads = right_input_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
+    uint64_t num_morsels = (right_input_size + PROBE_MORSEL_SIZE - 1) / PROBE_MORSEL_SIZE;
+    uint64_t num_partitions = left_input_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *join_prep_time += (end_time - begin_time);
     begin_time = omp_get_wtime();
 
-    // Build phase
-    vector<HT> hash_maps(num_threads);
-    vector<uint64_t> rem(left_input_size);
-    vector<uint64_t> quot(left_input_size);
-    #pragma omp parallel num_threads(num_threads)
-    {
-        uint64_t tid = omp_get_thread_num();
-        uint64_t start = left_size_per_thread * tid;
-        uint64_t end = start + left_size_per_thread;
-        if (end > left_input_size) end = left_input_size;
-        for (uint64_t i = start; i < end; ++i) {
-            rem[i] = left_key_column[i] % num_threads;
-            quot[i] = left_key_column[i] / num_threads;
-        }
-
-        #pragma omp barrier
-        hash_maps[tid].reserve(left_size_per_thread * RESERVE_FACTOR);
-
-        for (uint64_t i = 0; i < left_input_size; ++i) {
-            if (rem[i] == tid) {
-                hash_maps[tid].emplace(quot[i], i);
-            }
-        }
+    // Build phase. Keys of the build side (e.g. primary keys) get a
+    // single-match table
+    bool unique = left_->isUnique(p_infos_[0].left);
+    auto build = [&]() {
+        auto table = make_shared<JoinHashTable>();
+        table->build(left_key_column, left_input_size, num_partitions, unique);
+        return SharedHashTable(move(table));
+    };
+    SharedHashTable hash_table;
+    string fingerprint;
+    if (cache_ && left_->baseFingerprint(fingerprint)) {
+        // Tuple ids of base relation scans are stable: share the table with
+        // other queries. Filtered scans are only cached if they recur.
+        auto key = JoinTableCache::key(p_infos_[0].left.rel_id, p_infos_[0].left.col_id,
+                                        fingerprint);
+        hash_table = cache_->get(key, !fingerprint.empty(), build);
+    } else {
+        hash_table = build();
     }
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *join_build_time += (end_time - begin_time);
     begin_time = omp_get_wtime();
 
-    // Probe phase
-    vector<vector<size_t>> thread_selected_ids(num_threads);
-    vector<size_t> thread_result_sizes = vector<size_t> (num_threads, 0);
-
-    vector<vector<uint64_t>> thread_left_selected(num_threads);
-    vector<vector<uint64_t>> thread_right_selected(num_threads);
-    vector<uint64_t> thread_sizes(num_threads);
-
-    #pragma omp parallel num_threads(num_threads)
-    {
-        uint64_t thread_id = omp_get_thread_num();
-        thread_left_selected[thread_id].reserve(right_input_size * RESERVE_FACTOR);
-        thread_right_selected[thread_id].reserve(right_input_size * RESERVE_FACTOR);
-        uint64_t start_ind = thread_id * right_size_per_thread;
-        uint64_t end_ind = (thread_id + 1) * right_size_per_thread;
-        if (end_ind > right_input_size)
-            end_ind = right_input_size;
-
-        for (uint64_t right_id = start_ind; right_id < end_ind; ++right_id) {
-            auto right_key_val = right_key_column[right_id];
-            HT &hashmap = hash_maps[right_key_val % num_threads];
-            auto range = hashmap.equal_range(right_key_val/num_threads);
-            for (auto iter = range.first; iter != range.second; ++iter) {
-                uint64_t left_id = iter->second;
-                thread_left_selected[thread_id].push_back(left_id);
-                thread_right_selected[thread_id].push_back(right_id);
+    // Row ids of the matches are 32-bit unless an input has too many tuples
+    dispatchRowId(max(left_input_size, right_input_size), [&](auto row_id) {
+        using RowId = decltype(row_id);
+
+        // Probe phase. Call emit(left_id, right_id) for every match of the probe
+        // tuples in [begin, end), except for matches with heavy hitters: call
+        // on_heavy(heavy hitter, right_id) instead
+        auto residuals_match = [&](uint64_t left_id, uint64_t right_id) {
+            for (size_t p = 0; p < num_residuals; ++p)
+                if (left_residual_cols[p][left_id] != right_residual_cols[p][right_id])
+                    return false;
+            return true;
+        };
+        auto probe = [&](uint64_t begin, uint64_t end, auto &&emit, auto &&on_heavy) {
+            if (hash_table->unique()) {
+                // At most one match per probe tuple
+                auto probe_one = [&](uint64_t right_id) {
+                    auto left_id = hash_table->find(right_key_column[right_id]);
+                    if (left_id && residuals_match(*left_id, right_id))
+                        emit(*left_id, right_id);
+                };
+                if (probe_mode_ == ProbeMode::GroupPrefetch) {
+                    for (uint64_t group = begin; group < end; group += PROBE_GROUP_SIZE) {
+                        uint64_t group_end = min<uint64_t>(group + PROBE_GROUP_SIZE, end);
+                        for (uint64_t right_id = group; right_id < group_end; ++right_id)
+                            hash_table->prefetch(right_key_column[right_id]);
+                        for (uint64_t right_id = group; right_id < group_end; ++right_id)
+                            probe_one(right_id);
+                    }
+                } else {
+                    for (uint64_t right_id = begin; right_id < end; ++right_id)
+                        probe_one(right_id);
+                }
+            } else {
+                for (uint64_t right_id = begin; right_id < end; ++right_id) {
+                    auto range = hash_table->equal_range(right_key_column[right_id]);
+                    for (auto iter = range.first; iter != range.second; ++iter) {
+                        if (JoinHashTable::heavy(iter->second))
+                            on_heavy(JoinHashTable::heavyIndex(iter->second), right_id);
+                        else if (residuals_match(iter->second, right_id))
+                            emit(iter->second, right_id);
+                    }
+                }
             }
+        };
+
+        // Probe every morsel once and keep its matches: their number gives the
+        // output offset of the morsel
+        uint64_t num_heavy = hash_table->num_heavy();
+        vector<uint64_t> morsel_counts(num_morsels, 0);
+        vector<ArenaVector<RowId>> morsel_left_ids(num_morsels);
+        vector<ArenaVector<RowId>> morsel_right_ids(num_morsels);
+        // The probe tuples of every morsel matching a heavy hitter
+        vector<vector<pair<uint64_t, RowId>>> morsel_heavy(num_heavy ? num_morsels : 0);
+        #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+        for (uint64_t m = 0; m < num_morsels; ++m) {
+            uint64_t begin = m * PROBE_MORSEL_SIZE;
+            uint64_t end = min<uint64_t>(begin + PROBE_MORSEL_SIZE, right_input_size);
+            auto &left_ids = morsel_left_ids[m];
+            auto &right_ids = morsel_right_ids[m];
+            left_ids.reserve(end - begin);
+            right_ids.reserve(end - begin);
+            probe(begin, end, [&](uint64_t left_id, uint64_t right_id) {
+                left_ids.push_back(left_id);
+                right_ids.push_back(right_id);
+            }, [&](uint64_t heavy, uint64_t right_id) {
+                morsel_heavy[m].emplace_back(heavy, right_id);
+            });
+            morsel_counts[m] = left_ids.size();
         }
-        thread_sizes[thread_id] = thread_right_selected[thread_id].size();
-    }
 
-    // Reduction
-    vector<size_t> thread_cum_sizes = vector<size_t> (num_threads + 1, 0);
-    result_size_ = 0;
-    for (uint64_t t = 0; t < num_threads; ++t) {
-        result_size_ += thread_sizes[t];
-        thread_cum_sizes[t+1] = thread_cum_sizes[t] + thread_sizes[t];
-    }
-
-    end_time = omp_get_wtime();
-    *join_probing_time += (end_time - begin_time);
-    begin_time = omp_get_wtime();
+        // The matches with a heavy hitter (all of its build tuples for every probe
+        // tuple) are split into tiles of about a morsel of results: ranges of its
+        // build tuples times slices of its probe tuples
+        struct HeavyTile {
+            uint64_t heavy;
+            uint64_t probe_begin, probe_end;
+            uint64_t build_begin, build_end;
+        };
+        vector<ArenaVector<RowId>> heavy_probes(num_heavy);
+        for (auto &probes : morsel_heavy) {
+            for (auto &entry : probes)
+                heavy_probes[entry.first].push_back(entry.second);
+            vector<pair<uint64_t, RowId>>().swap(probes);
+        }
+        vector<HeavyTile> tiles;
+        for (uint64_t h = 0; h < num_heavy; ++h) {
+            auto build_ids = hash_table->heavyIds(h);
+            uint64_t build_size = build_ids.second - build_ids.first;
+            uint64_t probe_size = heavy_probes[h].size();
+            uint64_t build_step = min<uint64_t>(build_size, PROBE_MORSEL_SIZE);
+            uint64_t probe_step = max<uint64_t>(1, PROBE_MORSEL_SIZE / build_step);
+            for (uint64_t p = 0; p < probe_size; p += probe_step) {
+                for (uint64_t b = 0; b < build_size; b += build_step) {
+                    tiles.push_back(HeavyTile{h, p, min(p + probe_step, probe_size),
+                                              b, min(b + build_step, build_size)});
+                }
+            }
+        }
+        auto probe_tile = [&](const HeavyTile &tile, auto &&emit) {
+            const uint64_t *build_ids = hash_table->heavyIds(tile.heavy).first;
+            auto &probes = heavy_probes[tile.heavy];
+            for (uint64_t p = tile.probe_begin; p < tile.probe_end; ++p) {
+                for (uint64_t b = tile.build_begin; b < tile.build_end; ++b) {
+                    if (residuals_match(build_ids[b], probes[p]))
+                        emit(build_ids[b], probes[p]);
+                }
+            }
+        };
+        // Count the matches of every tile, then take the prefix sums: the output
+        // offset of each morsel and tile
+        uint64_t num_units = num_morsels + tiles.size();
+        vector<uint64_t> offsets(num_units + 1, 0);
+        #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+        for (uint64_t t = 0; t < tiles.size(); ++t) {
+            auto &tile = tiles[t];
+            uint64_t count = 0;
+            if (num_residuals == 0)
+                count = (tile.probe_end - tile.probe_begin) * (tile.build_end - tile.build_begin);
+            else
+                probe_tile(tile, [&](uint64_t, uint64_t) { ++count; });
+            offsets[num_morsels + t + 1] = count;
+        }
+        for (uint64_t m = 0; m < num_morsels; ++m)
+            offsets[m + 1] = morsel_counts[m];
+        for (uint64_t u = 0; u < num_units; ++u)
+            offsets[u + 1] += offsets[u];
+        result_size_ = offsets[num_units];
 
-    // Materialization phase
-    for (size_t c = 0; c < tot_num_cols; ++c) {
-        tmp_results_[c].reserve(result_size_);
-    }
+        end_time = omp_get_wtime();
+        #pragma omp atomic
+        *join_probing_time += (end_time - begin_time);
+        begin_time = omp_get_wtime();
 
-    #pragma omp parallel num_threads(num_threads)
-    {
-        uint64_t thread_id = omp_get_thread_num();
-        vector<size_t> &left_ids = thread_left_selected[thread_id];
-        vector<size_t> &right_ids = thread_right_selected[thread_id];
-        size_t t_size = thread_sizes[thread_id];
-        size_t cur_ind = thread_cum_sizes[thread_id];
+        // Materialization phase: copy the columns of the matches of every morsel
+        // and tile to its offset in the exactly sized results
+        vector<uint64_t *> result_cols(tot_num_cols);
+        for (size_t c = 0; c < tot_num_cols; ++c) {
+            tmp_results_[c].resize(result_size_);
+            result_cols[c] = tmp_results_[c].data();
+        }
 
-        for (uint64_t i = 0; i < t_size; ++i) {
-            size_t left_id = left_ids[i];
-            size_t right_id = right_ids[i];
-            for (unsigned cId = 0; cId < left_num_cols; ++cId) {
-                tmp_results_[cId][cur_ind] = copy_left_data_[cId][left_id];
-            }
-            for (unsigned cId = 0; cId < right_num_cols; ++cId) {
-                tmp_results_[left_num_cols+cId][cur_ind] = copy_right_data_[cId][right_id];
+        #pragma omp parallel num_threads(num_threads)
+        {
+            // Matches of a tile (reused across them)
+            vector<RowId> thread_left_ids, thread_right_ids;
+            #pragma omp for schedule(dynamic)
+            for (uint64_t u = 0; u < num_units; ++u) {
+                uint64_t count = offsets[u + 1] - offsets[u];
+                if (count == 0)
+                    continue;
+                const RowId *left_ids, *right_ids;
+                if (u < num_morsels) {
+                    left_ids = morsel_left_ids[u].data();
+                    right_ids = morsel_right_ids[u].data();
+                } else {
+                    thread_left_ids.resize(count);
+                    thread_right_ids.resize(count);
+                    uint64_t i = 0;
+                    probe_tile(tiles[u - num_morsels], [&](uint64_t left_id, uint64_t right_id) {
+                        thread_left_ids[i] = left_id;
+                        thread_right_ids[i] = right_id;
+                        ++i;
+                    });
+                    left_ids = thread_left_ids.data();
+                    right_ids = thread_right_ids.data();
+                }
+
+                uint64_t offset = offsets[u];
+                if (left_num_cols) {
+                    Gather<RowId> gather(left_ids, count, left_input_size);
+                    for (unsigned cId = 0; cId < left_num_cols; ++cId)
+                        gather.gather(copy_left_data_[cId], result_cols[cId] + offset);
+                }
+                if (right_num_cols) {
+                    Gather<RowId> gather(right_ids, count, right_input_size);
+                    for (unsigned cId = 0; cId < right_num_cols; ++cId)
+                        gather.gather(copy_right_data_[cId], result_cols[left_num_cols + cId] + offset);
+                }
+                if (u < num_morsels) {
+                    morsel_left_ids[u].clear();
+                    morsel_left_ids[u].shrink_to_fit();
+                    morsel_right_ids[u].clear();
+                    morsel_right_ids[u].shrink_to_fit();
+                }
             }
-            cur_ind++;
         }
-    }
+    });
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *join_materialization_time += (end_time - begin_time);
 }
 
@@ -373,6 +701,11 @@ bool SelfJoin::require(SelectInfo info) {
     return false;
 }
 
+// Describe the operator
+std::string SelfJoin::describe() const {
+    return "SelfJoin " + PredicateInfo(p_info_).dumpText();
+}
+
 // Run
 void SelfJoin::run() {
 
@@ -398,116 +731,414 @@ void SelfJoin::run() {
     auto right_col = input_data_[right_col_id];
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *self_join_prep_time += (end_time - begin_time);
     begin_time = omp_get_wtime();
 
-    // Single-Thread
-    if (input_data_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION) {
-        // Probing
-        uint64_t *selected = new uint64_t [input_data_size];
-        result_size_ = 0;
+    // Row ids of the matches are 32-bit unless the input has too many tuples
+    dispatchRowId(input_data_size, [&](auto row_id) {
+        using RowId = decltype(row_id);
+
+        // Single-Thread
+        if (input_data_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION) {
+            // Probing
+            ArenaVector<RowId> selected(input_data_size);
+            result_size_ = 0;
+
+            for (uint64_t i = 0; i < input_data_size; ++i) {
+                if (left_col[i] == right_col[i]) {
+                    selected[result_size_] = i;
+                    result_size_++;
+                }
+            }
 
-        for (uint64_t i = 0; i < input_data_size; ++i) {
-            if (left_col[i] == right_col[i]) {
-                selected[result_size_] = i;
-                result_size_++;
+            end_time = omp_get_wtime();
+            #pragma omp atomic
+            *self_join_probing_time += (end_time - begin_time);
+            begin_time = omp_get_wtime();
+
+            // Materialization
+            uint64_t **col_ptrs = new uint64_t* [tot_num_cols];
+            for (size_t cId = 0; cId < tot_num_cols; ++cId) {
+                auto &col = tmp_results_[cId];
+                col.resize(result_size_);
+                col_ptrs[cId] = col.data();
             }
+
+            for (uint64_t i = 0; i < result_size_; ++i) {
+                uint64_t id = selected[i];
+                for (unsigned cId = 0; cId < tot_num_cols; ++cId)
+                    col_ptrs[cId][i] = copy_data_[cId][id];
+            }
+
+            delete [] col_ptrs;
+            return;
+        }
+
+        // Multi-thread
+        // Probing
+        uint64_t size_per_thread = (input_data_size / NUM_THREADS) + (input_data_size % NUM_THREADS != 0);
+        vector<ArenaVector<RowId>> thread_selected_ids(NUM_THREADS);
+        size_t thread_result_sizes[NUM_THREADS];
+
+        #pragma omp parallel for num_threads(NUM_THREADS)
+        for (uint64_t thread_id = 0; thread_id < NUM_THREADS; ++thread_id) {
+            thread_selected_ids[thread_id].resize(size_per_thread);
+            RowId *selected = thread_selected_ids[thread_id].data();
+            size_t thread_size = 0;
+
+            uint64_t start_ind = thread_id * size_per_thread;
+            uint64_t end_ind = start_ind + size_per_thread;
+            if (end_ind > input_data_size) end_ind = input_data_size;
+
+            for (uint64_t i = start_ind; i < end_ind; ++i) {
+                if (left_col[i] == right_col[i]) {
+                    selected[thread_size] = i;
+                    ++thread_size;
+                }
+            }
+            thread_result_sizes[thread_id] = thread_size;
+        }
+
+        // Reduction
+        size_t thread_cum_sizes [NUM_THREADS + 1] = {0};
+        result_size_ = 0;
+        for (uint64_t t = 0; t < NUM_THREADS; ++t) {
+            thread_cum_sizes[t+1] = thread_cum_sizes[t] + thread_result_sizes[t];
+            result_size_ += thread_result_sizes[t];
         }
 
         end_time = omp_get_wtime();
+        #pragma omp atomic
         *self_join_probing_time += (end_time - begin_time);
         begin_time = omp_get_wtime();
 
-        // Materialization
+        // Merge
         uint64_t **col_ptrs = new uint64_t* [tot_num_cols];
         for (size_t cId = 0; cId < tot_num_cols; ++cId) {
-            vector<uint64_t> &col = tmp_results_[cId];
-            col.reserve(result_size_);
+            auto &col = tmp_results_[cId];
+            col.resize(result_size_);
             col_ptrs[cId] = col.data();
         }
 
-        for (uint64_t i = 0; i < result_size_; ++i) {
-            uint64_t id = selected[i];
-            for (unsigned cId = 0; cId < tot_num_cols; ++cId)
-                col_ptrs[cId][i] = copy_data_[cId][id];
+        #pragma omp parallel for num_threads(NUM_THREADS)
+        for (uint64_t tid = 0; tid < NUM_THREADS; ++tid) {
+            const RowId *selected = thread_selected_ids[tid].data();
+            size_t t_size = thread_result_sizes[tid];
+            size_t cur_ind = thread_cum_sizes[tid];
+
+            for (uint64_t i = 0; i < t_size; ++i) {
+                uint64_t id = selected[i];
+                for (unsigned cId = 0; cId < tot_num_cols; ++cId)
+                    col_ptrs[cId][cur_ind] = copy_data_[cId][id];
+                cur_ind++;
+            }
         }
 
-        delete [] selected;
+        end_time = omp_get_wtime();
+        #pragma omp atomic
+        *self_join_materialization_time += (end_time - begin_time);
+
         delete [] col_ptrs;
-        return;
+    });
+}
+
+// Require a column and add it to results
+bool SemiJoin::require(SelectInfo info) {
+    if (required_IUs_.count(info))
+        return true;
+    if (input_->require(info)) {
+        tmp_results_.emplace_back();
+        select_to_result_col_id_[info] = tmp_results_.size() - 1;
+        required_IUs_.emplace(info);
+        return true;
     }
+    return false;
+}
 
-    // Multi-thread
-    // Probing
-    uint64_t size_per_thread = (input_data_size / NUM_THREADS) + (input_data_size % NUM_THREADS != 0);
-    size_t *thread_selected_ids[NUM_THREADS];
-    size_t thread_result_sizes[NUM_THREADS];
+// Describe the operator
+std::string SemiJoin::describe() const {
+    return "SemiJoin " + PredicateInfo(column_, lookup_column_).dumpText();
+}
 
-    #pragma omp parallel num_threads(NUM_THREADS)
-    {
-        uint64_t thread_id = omp_get_thread_num();
-        thread_selected_ids[thread_id] = new size_t[size_per_thread];
-        size_t *selected = thread_selected_ids[thread_id];
-        size_t thread_size = 0;
+// Run
+void SemiJoin::run() {
+    input_->require(column_);
+    input_->run();
+    // Nothing to look up: the lookup table is not needed
+    if (input_->result_size() == 0)
+        return;
 
-        uint64_t start_ind = thread_id * size_per_thread;
-        uint64_t end_ind = start_ind + size_per_thread;
-        if (end_ind > input_data_size) end_ind = input_data_size;
+    double begin_time = omp_get_wtime();
+
+    // The table on the lookup column is the one a join with an unfiltered
+    // scan of the relation would build
+    uint64_t lookup_size = lookup_.size();
+    auto build = [&]() {
+        auto table = make_shared<JoinHashTable>();
+        table->build(lookup_.columns()[lookup_column_.col_id], lookup_size,
+                     lookup_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS,
+                     lookup_.isUnique(lookup_column_.col_id));
+        return SharedHashTable(move(table));
+    };
+    SharedHashTable hash_table = cache_
+        ? cache_->get(JoinTableCache::key(lookup_column_.rel_id, lookup_column_.col_id, ""),
+                      false, build)
+        : build();
+
+    auto input_data = input_->getResults();
+    auto column = input_data[input_->resolve(column_)];
+    uint64_t input_size = input_->result_size();
+    uint64_t num_threads = input_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
+    uint64_t size_per_thread = (input_size / num_threads) + (input_size % num_threads != 0);
+
+    // Row ids of the selected tuples are 32-bit unless the input has too
+    // many tuples
+    dispatchRowId(input_size, [&](auto row_id) {
+        using RowId = decltype(row_id);
+
+        // Select the tuples whose value occurs in the lookup column
+        vector<ArenaVector<RowId>> thread_selected(num_threads);
+        #pragma omp parallel for num_threads(num_threads)
+        for (uint64_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+            uint64_t start = thread_id * size_per_thread;
+            uint64_t end = min(start + size_per_thread, input_size);
+            auto &selected = thread_selected[thread_id];
+            if (start < end)
+                selected.reserve(end - start);
+            for (uint64_t i = start; i < end; ++i) {
+                bool found;
+                if (hash_table->unique()) {
+                    found = hash_table->find(column[i]) != nullptr;
+                } else {
+                    auto range = hash_table->equal_range(column[i]);
+                    found = range.first != range.second;
+                }
+                if (found)
+                    selected.push_back(i);
+            }
+        }
+        vector<uint64_t> offsets(num_threads + 1, 0);
+        for (uint64_t t = 0; t < num_threads; ++t)
+            offsets[t + 1] = offsets[t] + thread_selected[t].size();
+        result_size_ = offsets[num_threads];
 
-        for (uint64_t i = start_ind; i < end_ind; ++i) {
-            if (left_col[i] == right_col[i]) {
-                selected[thread_size] = i;
-                ++thread_size;
+        // Materialization
+        vector<uint64_t *> copy_data;
+        for (auto &info : required_IUs_) {
+            copy_data.push_back(input_data[input_->resolve(info)]);
+            tmp_results_[select_to_result_col_id_[info]].resize(result_size_);
+        }
+        #pragma omp parallel for num_threads(num_threads)
+        for (uint64_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+            auto &selected = thread_selected[thread_id];
+            unsigned c = 0;
+            for (auto &info : required_IUs_) {
+                auto &result = tmp_results_[select_to_result_col_id_[info]];
+                for (uint64_t i = 0; i < selected.size(); ++i)
+                    result[offsets[thread_id] + i] = copy_data[c][selected[i]];
+                ++c;
             }
         }
-        thread_result_sizes[thread_id] = thread_size;
+    });
+
+    #pragma omp atomic
+    *semi_join_time += omp_get_wtime() - begin_time;
+}
+
+// Require a column and add it to results
+bool StarJoin::require(SelectInfo info) {
+    if (select_to_result_col_id_.count(info))
+        return true;
+    int source = -1;
+    if (!fact_->require(info)) {
+        source = 0;
+        while (source < static_cast<int>(dimensions_.size()) && !dimensions_[source]->require(info))
+            ++source;
+        if (source == static_cast<int>(dimensions_.size()))
+            return false;
     }
+    requested_columns_.emplace_back(info, source);
+    tmp_results_.emplace_back();
+    select_to_result_col_id_[info] = tmp_results_.size() - 1;
+    return true;
+}
 
-    // Reduction
-    size_t thread_cum_sizes [NUM_THREADS + 1] = {0};
-    result_size_ = 0;
-    for (uint64_t t = 0; t < NUM_THREADS; ++t) {
-        thread_cum_sizes[t+1] = thread_cum_sizes[t] + thread_result_sizes[t];
-        result_size_ += thread_result_sizes[t];
+// Describe the operator
+std::string StarJoin::describe() const {
+    std::string out = "StarJoin ";
+    for (size_t i = 0; i < p_infos_.size(); ++i) {
+        out += PredicateInfo(p_infos_[i]).dumpText();
+        if (i < p_infos_.size() - 1)
+            out += PredicateInfo::delimiter;
     }
+    return out;
+}
 
-    end_time = omp_get_wtime();
-    *self_join_probing_time += (end_time - begin_time);
-    begin_time = omp_get_wtime();
+// The input operators
+std::vector<const Operator *> StarJoin::children() const {
+    std::vector<const Operator *> children{fact_.get()};
+    for (auto &dimension : dimensions_)
+        children.push_back(dimension.get());
+    return children;
+}
 
-    // Merge
-    for (size_t c = 0; c < tot_num_cols; ++c) {
-        tmp_results_[c].reserve(result_size_);
+// Run
+void StarJoin::run() {
+    size_t num_dimensions = dimensions_.size();
+    for (size_t d = 0; d < num_dimensions; ++d) {
+        fact_->require(p_infos_[d].left);
+        dimensions_[d]->require(p_infos_[d].right);
     }
-
-    uint64_t **col_ptrs = new uint64_t* [tot_num_cols];
-    for (size_t cId = 0; cId < tot_num_cols; ++cId) {
-        vector<uint64_t> &col = tmp_results_[cId];
-        col.reserve(result_size_);
-        col_ptrs[cId] = col.data();
+    // An empty input makes the remaining ones needless
+    fact_->run();
+    bool empty = fact_->result_size() == 0;
+    for (auto &dimension : dimensions_) {
+        if (empty) {
+            dimension->skip();
+        } else {
+            dimension->run();
+            empty = dimension->result_size() == 0;
+        }
     }
+    if (empty)
+        return;
 
-    #pragma omp parallel num_threads(NUM_THREADS)
-    {
-        uint64_t tid = omp_get_thread_num();
-        size_t *selected = thread_selected_ids[tid];
-        size_t t_size = thread_result_sizes[tid];
-        size_t cur_ind = thread_cum_sizes[tid];
-
-        for (uint64_t i = 0; i < t_size; ++i) {
-            uint64_t id = selected[i];
-            for (unsigned cId = 0; cId < tot_num_cols; ++cId)
-                col_ptrs[cId][cur_ind] = copy_data_[cId][id];
-            cur_ind++;
+    double begin_time = omp_get_wtime();
+
+    // Build phase: one table per dimension (shared with other queries for
+    // base relation scans, as in Join)
+    vector<SharedHashTable> tables(num_dimensions);
+    vector<const uint64_t *> fact_keys(num_dimensions);
+    auto fact_data = fact_->getResults();
+    for (size_t d = 0; d < num_dimensions; ++d) {
+        auto &dimension = *dimensions_[d];
+        auto &column = p_infos_[d].right;
+        const uint64_t *keys = dimension.getResults()[dimension.resolve(column)];
+        uint64_t size = dimension.result_size();
+        auto build = [&]() {
+            auto table = make_shared<JoinHashTable>();
+            table->build(keys, size,
+                         size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS,
+                         dimension.isUnique(column));
+            return SharedHashTable(move(table));
+        };
+        string fingerprint;
+        if (cache_ && dimension.baseFingerprint(fingerprint)) {
+            auto key = JoinTableCache::key(column.rel_id, column.col_id, fingerprint);
+            tables[d] = cache_->get(key, !fingerprint.empty(), build);
+        } else {
+            tables[d] = build();
         }
+        fact_keys[d] = fact_data[fact_->resolve(p_infos_[d].left)];
     }
 
-    end_time = omp_get_wtime();
-    *self_join_materialization_time += (end_time - begin_time);
+    // Probe the dimension missing the most (sampled) fact tuples first
+    auto matches = [&](size_t d, uint64_t key) {
+        if (tables[d]->unique())
+            return tables[d]->find(key) != nullptr;
+        auto range = tables[d]->equal_range(key);
+        return range.first != range.second;
+    };
+    uint64_t fact_size = fact_->result_size();
+    uint64_t stride = max<uint64_t>(1, fact_size / FILTER_SAMPLE_SIZE);
+    vector<uint64_t> matched(num_dimensions, 0);
+    for (uint64_t i = 0; i < fact_size; i += stride) {
+        for (size_t d = 0; d < num_dimensions; ++d)
+            matched[d] += matches(d, fact_keys[d][i]);
+    }
+    probe_order_.resize(num_dimensions);
+    for (unsigned d = 0; d < num_dimensions; ++d)
+        probe_order_[d] = d;
+    stable_sort(probe_order_.begin(), probe_order_.end(),
+        [&](unsigned a, unsigned b) { return matched[a] < matched[b]; });
+
+    uint64_t num_threads = fact_size < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
+    uint64_t size_per_thread = (fact_size / num_threads) + (fact_size % num_threads != 0);
+    uint64_t max_size = fact_size;
+    for (auto &dimension : dimensions_)
+        max_size = max(max_size, dimension->result_size());
+
+    // Row ids are 32-bit unless an input has too many tuples
+    dispatchRowId(max_size, [&](auto row_id) {
+        using RowId = decltype(row_id);
+
+        // Probe phase: the ids of the fact tuple (first) and of the dimension
+        // tuples of every result tuple
+        vector<vector<ArenaVector<RowId>>> thread_ids(num_threads,
+                                                      vector<ArenaVector<RowId>>(num_dimensions + 1));
+        #pragma omp parallel for num_threads(num_threads)
+        for (uint64_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+            uint64_t start = thread_id * size_per_thread;
+            uint64_t end = min(start + size_per_thread, fact_size);
+            auto &ids = thread_ids[thread_id];
+            vector<ArenaVector<RowId>> dimension_ids(num_dimensions);
+            vector<size_t> position(num_dimensions);
+            for (uint64_t i = start; i < end; ++i) {
+                bool complete = true;
+                for (size_t k = 0; k < num_dimensions && complete; ++k) {
+                    unsigned d = probe_order_[k];
+                    auto &table = *tables[d];
+                    dimension_ids[d].clear();
+                    if (table.unique()) {
+                        auto id = table.find(fact_keys[d][i]);
+                        if (id)
+                            dimension_ids[d].push_back(*id);
+                    } else {
+                        table.forEachMatch(fact_keys[d][i],
+                            [&](uint64_t id) { dimension_ids[d].push_back(id); });
+                    }
+                    complete = !dimension_ids[d].empty();
+                }
+                if (!complete)
+                    continue;
+                // Every combination of the matching dimension tuples
+                fill(position.begin(), position.end(), 0);
+                for (size_t d = num_dimensions; d > 0;) {
+                    ids[0].push_back(i);
+                    for (size_t k = 0; k < num_dimensions; ++k)
+                        ids[k + 1].push_back(dimension_ids[k][position[k]]);
+                    for (d = num_dimensions; d > 0; --d) {
+                        if (++position[d - 1] < dimension_ids[d - 1].size())
+                            break;
+                        position[d - 1] = 0;
+                    }
+                }
+            }
+        }
+        vector<uint64_t> offsets(num_threads + 1, 0);
+        for (uint64_t t = 0; t < num_threads; ++t)
+            offsets[t + 1] = offsets[t] + thread_ids[t][0].size();
+        result_size_ = offsets[num_threads];
+
+        // Materialization
+        vector<const uint64_t *> copy_data;
+        for (auto &requested : requested_columns_) {
+            int source = requested.second;
+            Operator &input = source < 0 ? *fact_ : *dimensions_[source];
+            copy_data.push_back(input.getResults()[input.resolve(requested.first)]);
+            tmp_results_[select_to_result_col_id_[requested.first]].resize(result_size_);
+        }
+        #pragma omp parallel for num_threads(num_threads)
+        for (uint64_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+            // One gather per input, shared by its requested columns
+            vector<unique_ptr<Gather<RowId>>> gathers(num_dimensions + 1);
+            for (size_t c = 0; c < requested_columns_.size(); ++c) {
+                int source = requested_columns_[c].second;
+                auto &gather = gathers[source + 1];
+                if (!gather) {
+                    auto &ids = thread_ids[thread_id][source + 1];
+                    Operator &input = source < 0 ? *fact_ : *dimensions_[source];
+                    gather = make_unique<Gather<RowId>>(ids.data(), ids.size(), input.result_size());
+                }
+                auto &result = tmp_results_[select_to_result_col_id_[requested_columns_[c].first]];
+                gather->gather(copy_data[c], result.data() + offsets[thread_id]);
+            }
+        }
+    });
 
-    for (size_t tid = 0; tid < NUM_THREADS; ++tid)
-        delete [] thread_selected_ids[tid];
-    delete [] col_ptrs;
+    #pragma omp atomic
+    *star_join_time += omp_get_wtime() - begin_time;
 }
 
 // Run
@@ -519,30 +1150,32 @@ void Checksum::run() {
 
     double begin_time = omp_get_wtime(), end_time;
 
-    auto results = input_->getResults();
     result_size_ = input_->result_size();
-
     auto old_num_cols = check_sums_.size();
     auto num_cols = col_info_.size();
     check_sums_.resize(old_num_cols + num_cols);
+    // The columns of inputs skipped after an empty join are not resolvable
+    if (result_size_ == 0)
+        return;
+
+    auto results = input_->getResults();
 
     uint64_t num_threads = result_size_ < NUM_THREADS * DEPTH_WORTHY_PARALLELIZATION ? 1 : NUM_THREADS;
 
-    #pragma omp parallel num_threads(num_threads)
-    {
-        for (size_t c = omp_get_thread_num(); c < num_cols; c += num_threads) {
-            const SelectInfo &sInfo = col_info_[c];
-            auto col_id = input_->resolve(sInfo);
-            uint64_t *result_col = results[col_id];
-            uint64_t sum = 0;
-            uint64_t *last = result_col + input_->result_size();
-
-            for (uint64_t *iter = result_col; iter != last; ++iter)
-                sum += *iter;
-            check_sums_[old_num_cols + c] = (sum);
-        }
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (size_t c = 0; c < num_cols; ++c) {
+        const SelectInfo &sInfo = col_info_[c];
+        auto col_id = input_->resolve(sInfo);
+        uint64_t *result_col = results[col_id];
+        uint64_t sum = 0;
+        uint64_t *last = result_col + input_->result_size();
+
+        for (uint64_t *iter = result_col; iter != last; ++iter)
+            sum += *iter;
+        check_sums_[old_num_cols + c] = (sum);
     }
 
     end_time = omp_get_wtime();
+    #pragma omp atomic
     *check_sum_time += (end_time - begin_time);
 }
\ No newline at end of file
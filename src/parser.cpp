@@ -1,7 +1,9 @@
 #include "parser.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <map>
 #include <utility>
 #include <sstream>
 
@@ -144,6 +146,97 @@ void QueryInfo::clear() {
     selections_.clear();
 }
 
+// The filters of a binding
+std::vector<FilterInfo> QueryInfo::filtersOf(unsigned binding) const {
+    std::vector<FilterInfo> filters;
+    for (auto &f : filters_) {
+        if (f.filter_column.binding == binding) {
+            filters.emplace_back(f);
+        }
+    }
+    return filters;
+}
+
+// Intersect with a filter, returns false if the range becomes empty
+bool ColumnRange::restrict(const FilterInfo &f) {
+    switch (f.comparison) {
+        case FilterInfo::Comparison::Equal:
+            low = std::max(low, f.constant);
+            high = std::min(high, f.constant);
+            break;
+        case FilterInfo::Comparison::Greater:
+            if (f.constant == std::numeric_limits<uint64_t>::max())
+                return false;
+            low = std::max(low, f.constant + 1);
+            break;
+        case FilterInfo::Comparison::Less:
+            if (f.constant == 0)
+                return false;
+            high = std::min(high, f.constant - 1);
+            break;
+    }
+    return low <= high;
+}
+
+// Express the range as filters on a column
+void ColumnRange::toFilters(const SelectInfo &column,
+                            std::vector<FilterInfo> &filters) const {
+    if (low == high) {
+        filters.emplace_back(column, low, FilterInfo::Comparison::Equal);
+        return;
+    }
+    if (low > 0)
+        filters.emplace_back(column, low - 1, FilterInfo::Comparison::Greater);
+    if (high < std::numeric_limits<uint64_t>::max())
+        filters.emplace_back(column, high + 1, FilterInfo::Comparison::Less);
+}
+
+// Propagate filters along join equivalence classes
+bool QueryInfo::inferFilters() {
+    // Union-find over the columns (binding, column id) of the join predicates
+    using Column = std::pair<unsigned, unsigned>;
+    std::map<Column, Column> parent;
+    std::map<Column, SelectInfo> infos;
+    auto find = [&parent](Column c) {
+        while (parent[c] != c) {
+            parent[c] = parent[parent[c]];
+            c = parent[c];
+        }
+        return c;
+    };
+    auto add = [&](const SelectInfo &s) {
+        Column c(s.binding, s.col_id);
+        if (parent.emplace(c, c).second)
+            infos.emplace(c, s);
+        return c;
+    };
+    for (auto &p_info : predicates_) {
+        auto left = find(add(p_info.left));
+        auto right = find(add(p_info.right));
+        parent[left] = right;
+    }
+    for (auto &f_info : filters_)
+        add(f_info.filter_column);
+
+    // Intersect the filters of all members of a class
+    std::map<Column, ColumnRange> ranges;
+    for (auto &f_info : filters_) {
+        auto root = find(Column(f_info.filter_column.binding, f_info.filter_column.col_id));
+        auto iter = ranges.emplace(root, ColumnRange(0)).first;
+        if (!iter->second.restrict(f_info))
+            return false;
+    }
+
+    // Restrict every member of a filtered class by the class range
+    filters_.clear();
+    for (auto &member : infos) {
+        auto range = ranges.find(find(member.first));
+        if (range != ranges.end())
+            range->second.toFilters(member.second, filters_);
+    }
+    return true;
+}
+
 // Appends a selection info to the stream
 std::string SelectInfo::dumpSQL(bool add_sum) {
     auto inner_part = wrapRelationName(binding) + ".c" + std::to_string(col_id);
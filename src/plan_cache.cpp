@@ -0,0 +1,90 @@
+#include "plan_cache.h"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+using namespace::std;
+
+// The template of a query
+string PlanCache::key(const QueryInfo &query) {
+    stringstream ss;
+    for (auto rel_id : query.relation_ids())
+        ss << rel_id << ' ';
+    ss << '|';
+    for (auto &p : query.predicates()) {
+        ss << p.left.binding << '.' << p.left.col_id << '=' << p.right.binding << '.'
+           << p.right.col_id << '&';
+    }
+    ss << '|';
+    // Filters in canonical order (the same filter might occur twice)
+    set<tuple<unsigned, unsigned, char>> filters;
+    for (auto &f : query.filters())
+        filters.emplace(f.filter_column.binding, f.filter_column.col_id, f.comparison);
+    for (auto &f : filters)
+        ss << get<0>(f) << '.' << get<1>(f) << get<2>(f) << '&';
+    ss << '|';
+    // Selected bindings: the inputs of key lookups depend on them
+    set<unsigned> selected;
+    for (auto &s : query.selections())
+        selected.insert(s.binding);
+    for (auto binding : selected)
+        ss << binding << ' ';
+    return ss.str();
+}
+
+// Look up the plan of a template
+bool PlanCache::lookup(const string &key, const vector<double> &scan_estimates,
+                       vector<unsigned> &order) {
+    lock_guard<mutex> lock(mutex_);
+    auto iter = index_.find(key);
+    if (iter == index_.end()) {
+        ++misses_;
+        return false;
+    }
+    auto &plan = iter->second->plan;
+    for (unsigned i = 0; i < scan_estimates.size(); ++i) {
+        double ratio = max(1.0, scan_estimates[i]) / max(1.0, plan.scan_estimates[i]);
+        if (ratio > factor_ || ratio < 1.0 / factor_) {
+            ++rejections_;
+            return false;
+        }
+    }
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    order = plan.order;
+    ++hits_;
+    return true;
+}
+
+// Insert (or replace) the plan of a template
+void PlanCache::insert(const string &key, CachedPlan plan) {
+    lock_guard<mutex> lock(mutex_);
+    auto iter = index_.find(key);
+    if (iter != index_.end()) {
+        iter->second->plan = move(plan);
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        return;
+    }
+    lru_.push_front(Entry{key, move(plan)});
+    index_.emplace(key, lru_.begin());
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+// Drop all entries
+void PlanCache::clear() {
+    lock_guard<mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+}
+
+// Print statistics
+void PlanCache::report(ostream &out) {
+    lock_guard<mutex> lock(mutex_);
+    out << "Plan cache: " << hits_ + misses_ + rejections_ << " lookups, " << hits_
+        << " reused plans, " << rejections_ << " rejected (changed estimates), "
+        << lru_.size() << " entries" << endl;
+}
@@ -1,26 +1,71 @@
 #include "relation.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <fstream>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include "arena.h"
 #include "omp.h"
 #include "utils.h"
 
 double *relation_writing_time = get_relation_writing_time();
 double *relation_reading_time = get_relation_reading_time();
 
+// Collect the metadata of a column
+ColumnMetadata computeColumnMetadata(const uint64_t *column, uint64_t size) {
+    ColumnMetadata metadata;
+    if (size == 0)
+        return metadata;
+    metadata.sorted = std::is_sorted(column, column + size);
+    std::vector<uint64_t> sorted;
+    if (!metadata.sorted) {
+        sorted.assign(column, column + size);
+        std::sort(sorted.begin(), sorted.end());
+    }
+    const uint64_t *values = metadata.sorted ? column : sorted.data();
+    metadata.min = values[0];
+    metadata.max = values[size - 1];
+    metadata.distinct = 1;
+    for (uint64_t i = 1; i < size; ++i)
+        metadata.distinct += values[i] != values[i - 1];
+    metadata.unique = metadata.distinct == size;
+    return metadata;
+}
+
 // Stores a relation into a binary file
-void Relation::storeRelation(const std::string &file_name) {
+void Relation::storeRelation(const std::string &file_name, RelationFormat format) {
 
     double start = omp_get_wtime();
 
     std::ofstream out_file;
     out_file.open(file_name, std::ios::out | std::ios::binary);
-    out_file.write((char *) &size_, sizeof(size_));
     auto numColumns = columns_.size();
-    out_file.write((char *) &numColumns, sizeof(size_t));
+    if (format == RelationFormat::V2) {
+        std::vector<ColumnMetadata> metadata = metadata_;
+        if (metadata.size() != numColumns) {
+            metadata.resize(numColumns);
+            #pragma omp parallel for schedule(dynamic)
+            for (size_t c = 0; c < numColumns; ++c)
+                metadata[c] = computeColumnMetadata(columns_[c], size_);
+        }
+        uint64_t header[] = {RELATION_V2_MAGIC, 2};
+        out_file.write((char *) header, sizeof(header));
+        out_file.write((char *) &size_, sizeof(size_));
+        out_file.write((char *) &numColumns, sizeof(size_t));
+        for (auto &m : metadata) {
+            uint64_t words[] = {m.min, m.max, m.distinct,
+                                uint64_t(m.sorted) | uint64_t(m.unique) << 1,
+                                static_cast<uint64_t>(m.encoding)};
+            out_file.write((char *) words, sizeof(words));
+        }
+    } else {
+        out_file.write((char *) &size_, sizeof(size_));
+        out_file.write((char *) &numColumns, sizeof(size_t));
+    }
     for (auto c : columns_) {
         out_file.write((char *) c, size_ * sizeof(uint64_t));
     }
@@ -62,7 +107,13 @@ void Relation::dumpSQL(const std::string &file_name, unsigned relation_id) {
              << ".tbl' delimiter '|';\n";
 }
 
-void Relation::loadRelation(const char *file_name) {
+// Unmaps the memory of a loaded relation
+void Relation::Unmap::operator()(char *addr) const {
+    munmap(addr, length);
+}
+
+// Loads a relation from a binary file
+void Relation::loadRelation(const char *file_name, LoadMode mode) {
 
     double start = omp_get_wtime();
 
@@ -79,17 +130,25 @@ void Relation::loadRelation(const char *file_name) {
 
     auto length = sb.st_size;
 
+    // A populated mapping is read (and its page-table entries are set up)
+    // now instead of page by page by the first query touching it
+    int flags = MAP_PRIVATE | (mode == LoadMode::Populate ? MAP_POPULATE : 0);
     char *addr = static_cast<char *>(mmap(nullptr,
                                           length,
                                           PROT_READ,
-                                          MAP_PRIVATE,
+                                          flags,
                                           fd,
                                           0u));
+    close(fd);
     if (addr == MAP_FAILED) {
         std::cerr << "cannot mmap " << file_name << " of length " << length
                   << std::endl;
         throw;
     }
+    if (mode == LoadMode::Populate)
+        madvise(addr, length, MADV_HUGEPAGE);
+    if (mode != LoadMode::Lazy)
+        madvise(addr, length, MADV_WILLNEED);
 
     if (length < 16) {
         std::cerr << "relation_ file " << file_name
@@ -98,23 +157,77 @@ void Relation::loadRelation(const char *file_name) {
         throw;
     }
 
-    this->size_ = *reinterpret_cast<uint64_t *>(addr);
-    addr += sizeof(size_);
-    auto numColumns = *reinterpret_cast<size_t *>(addr);
-    addr += sizeof(size_t);
+    auto header = reinterpret_cast<const uint64_t *>(addr);
+    size_t header_words = 2;
+    if (header[0] == RELATION_V2_MAGIC) {
+        // Version 2: the metadata of every column (5 words) follows
+        if (length < 32 || header[1] != 2) {
+            std::cerr << "relation_ file " << file_name
+                      << " has an unsupported format version" << std::endl;
+            throw;
+        }
+        header += 2;
+        header_words = 4 + 5 * header[1];
+        if (static_cast<uint64_t>(length) < header_words * sizeof(uint64_t)) {
+            std::cerr << "relation_ file " << file_name
+                      << " does not contain a valid header" << std::endl;
+            throw;
+        }
+        this->metadata_.resize(header[1]);
+        for (size_t c = 0; c < header[1]; ++c) {
+            auto words = header + 2 + 5 * c;
+            auto &m = this->metadata_[c];
+            m.min = words[0];
+            m.max = words[1];
+            m.distinct = words[2];
+            m.sorted = words[3] & 1;
+            m.unique = words[3] & 2;
+            m.encoding = static_cast<ColumnEncoding>(words[4]);
+            if (m.encoding != ColumnEncoding::Plain) {
+                std::cerr << "relation_ file " << file_name
+                          << " uses an unsupported column encoding" << std::endl;
+                throw;
+            }
+        }
+    }
+
+    this->size_ = header[0];
+    auto numColumns = header[1];
+    char *data = addr + header_words * sizeof(uint64_t);
+    uint64_t column_bytes = size_ * sizeof(uint64_t);
+
+    if (mode == LoadMode::Copy) {
+        // Copy the columns into huge pages and drop the file mapping
+        size_t copy_length = (std::max<size_t>(numColumns * column_bytes, 1)
+                              + ARENA_BLOCK_ALIGNMENT - 1) & ~(ARENA_BLOCK_ALIGNMENT - 1);
+        char *copy = mapHugePages(copy_length);
+        #pragma omp parallel for schedule(dynamic)
+        for (unsigned i = 0; i < numColumns; ++i)
+            memcpy(copy + column_bytes * i, data + column_bytes * i, column_bytes);
+        munmap(addr, length);
+        this->mapping_ = std::unique_ptr<char, Unmap>(copy, Unmap{copy_length});
+        data = copy;
+    } else {
+        this->mapping_ = std::unique_ptr<char, Unmap>(addr, Unmap{static_cast<size_t>(length)});
+    }
+
     this->columns_.resize(numColumns);
     #pragma omp parallel for
     for (unsigned i = 0; i < numColumns; ++i) {
-        char *current = addr + size_ * sizeof(uint64_t) * i;
+        char *current = data + column_bytes * i;
         this->columns_[i] = (reinterpret_cast<uint64_t *>(current));
     }
+    for (unsigned i = 0; i < this->metadata_.size(); ++i)
+        setUnique(i, this->metadata_[i].unique);
 
+    // Relations may be loaded concurrently
+    #pragma omp atomic
     *relation_reading_time += (omp_get_wtime() - start);
 }
 
 // Constructor that loads relation_ from disk
-Relation::Relation(const char *file_name) : owns_memory_(false), size_(0) {
-    loadRelation(file_name);
+Relation::Relation(const char *file_name, LoadMode mode) : owns_memory_(false), size_(0) {
+    loadRelation(file_name, mode);
 }
 
 // Destructor
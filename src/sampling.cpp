@@ -0,0 +1,290 @@
+#include "sampling.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+
+#include <omp.h>
+
+#include "scan_cache.h"
+
+using namespace::std;
+
+namespace {
+
+/// Check the deadline every that many sampled tuples
+constexpr uint64_t kDeadlineCheckInterval = 64;
+
+/// The tuple passes the normalized filters of its relation
+bool passes(const Relation &relation, const FilterKey &key, uint64_t row) {
+    for (auto &range : key.ranges()) {
+        if (!range.contains(relation.columns()[range.col_id][row]))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// Build the index of a column
+void ColumnIndex::build(const uint64_t *column, uint64_t size) {
+    uint32_t *ids = new uint32_t[size];
+    for (uint64_t i = 0; i < size; ++i)
+        ids[i] = i;
+    sort(ids, ids + size, [column](uint32_t a, uint32_t b) {
+        return column[a] < column[b];
+    });
+    assign(column, shared_ptr<const uint32_t>(ids, default_delete<const uint32_t[]>()), size);
+}
+
+// Use row ids sorted by value that were built before
+void ColumnIndex::assign(const uint64_t *column, shared_ptr<const uint32_t> ids, uint64_t size) {
+    column_ = column;
+    ids_ = move(ids);
+    size_ = size;
+}
+
+// The row ids of all tuples with a value
+pair<const uint32_t *, const uint32_t *> ColumnIndex::equal_range(uint64_t value) const {
+    auto column = column_;
+    auto begin = ids_.get(), end = ids_.get() + size_;
+    auto first = lower_bound(begin, end, value,
+                             [column](uint32_t id, uint64_t v) { return column[id] < v; });
+    auto last = upper_bound(first, end, value,
+                            [column](uint64_t v, uint32_t id) { return v < column[id]; });
+    return {first, last};
+}
+
+// Draw the samples and build the indexes
+void SamplingEstimator::build(const vector<Relation> &relations,
+                              vector<vector<ColumnIndex>> &&indexes) {
+    relations_ = &relations;
+    samples_.assign(relations.size(), {});
+    indexes_ = move(indexes);
+    indexes_.resize(relations.size());
+
+    // A fixed seed keeps plans reproducible across runs
+    mt19937_64 rng(42);
+    vector<pair<unsigned, unsigned>> columns;
+    for (unsigned r = 0; r < relations.size(); ++r) {
+        auto &relation = relations[r];
+        auto &sample = samples_[r];
+        if (relation.size() <= SAMPLE_SIZE) {
+            sample.resize(relation.size());
+            for (uint64_t i = 0; i < relation.size(); ++i)
+                sample[i] = i;
+        } else {
+            // Floyd's algorithm: SAMPLE_SIZE distinct row ids
+            set<uint64_t> chosen;
+            for (uint64_t j = relation.size() - SAMPLE_SIZE; j < relation.size(); ++j) {
+                uint64_t t = uniform_int_distribution<uint64_t>(0, j)(rng);
+                chosen.insert(chosen.count(t) ? j : t);
+            }
+            sample.assign(chosen.begin(), chosen.end());
+        }
+        // Random order: any prefix of a sample is a sample as well
+        shuffle(sample.begin(), sample.end(), rng);
+
+        if (!indexes_[r].empty())
+            continue;
+        indexes_[r].resize(relation.columns().size());
+        for (unsigned c = 0; c < relation.columns().size(); ++c)
+            columns.emplace_back(r, c);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned i = 0; i < columns.size(); ++i) {
+        auto &relation = relations[columns[i].first];
+        indexes_[columns[i].first][columns[i].second].build(
+            relation.columns()[columns[i].second], relation.size());
+    }
+}
+
+// Estimated number of tuples of a binding passing its filters
+bool SamplingEstimator::estimateScan(const QueryInfo &query, unsigned binding,
+                                     double &size) const {
+    RelationId rel_id = query.relation_ids()[binding];
+    auto &relation = (*relations_)[rel_id];
+    auto &sample = samples_[rel_id];
+    FilterKey key(rel_id, query.filtersOf(binding));
+    if (sample.empty() || key.unsatisfiable()) {
+        size = 0.0;
+        return true;
+    }
+
+    uint64_t count = 0;
+    for (auto row : sample)
+        count += passes(relation, key, row);
+    // Less than a single sampled tuple
+    size = 1.0 * max<uint64_t>(count, 1) * relation.size() / sample.size();
+    return count > 0;
+}
+
+// Estimated result size of joining a set of bindings
+bool SamplingEstimator::estimate(const QueryInfo &query, const set<unsigned> &bindings,
+                                 double deadline, double &size) const {
+    if (bindings.size() == 1)
+        return estimateScan(query, *bindings.begin(), size);
+    size = numeric_limits<double>::infinity();
+
+    auto &relations = *relations_;
+    auto &rel_ids = query.relation_ids();
+    map<unsigned, FilterKey> keys;
+    for (auto binding : bindings)
+        keys.emplace(binding, FilterKey(rel_ids[binding], query.filtersOf(binding)));
+
+    // The qualifying sampled tuples of every binding; start with the binding
+    // with the most qualifying ones (most evidence)
+    unsigned start = *bindings.begin();
+    vector<uint64_t> best;
+    for (auto binding : bindings) {
+        auto &relation = relations[rel_ids[binding]];
+        auto &key = keys.at(binding);
+        if (key.unsatisfiable()) {
+            size = 0.0;
+            return true;
+        }
+        vector<uint64_t> qualifying;
+        for (auto row : samples_[rel_ids[binding]]) {
+            if (!passes(relation, key, row))
+                continue;
+            // Predicates between two columns of the binding itself
+            bool match = true;
+            for (auto &p_info : query.predicates()) {
+                if (p_info.left.binding == binding && p_info.right.binding == binding
+                    && relation.columns()[p_info.left.col_id][row]
+                       != relation.columns()[p_info.right.col_id][row]) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match)
+                qualifying.push_back(row);
+        }
+        if (qualifying.size() > best.size()) {
+            best = move(qualifying);
+            start = binding;
+        }
+    }
+    if (best.empty()) {
+        // Bounded by the smallest scan
+        for (auto binding : bindings) {
+            double scan_size;
+            estimateScan(query, binding, scan_size);
+            size = min(size, scan_size);
+        }
+        return false;
+    }
+
+    // Sampled join tuples: one row id per joined binding (in join order)
+    vector<unsigned> joined{start};
+    map<unsigned, unsigned> slots{{start, 0}};
+    vector<uint64_t> tuples = move(best);
+    double scale = 1.0 * relations[rel_ids[start]].size() / samples_[rel_ids[start]].size();
+
+    while (joined.size() < bindings.size()) {
+        // Find a binding connected to the joined ones and all its predicates
+        const PredicateInfo *index_predicate = nullptr;
+        unsigned next = 0;
+        for (auto &p_info : query.predicates()) {
+            bool left_in = slots.count(p_info.left.binding);
+            bool right_in = slots.count(p_info.right.binding);
+            if (left_in && !right_in && bindings.count(p_info.right.binding)) {
+                next = p_info.right.binding;
+            } else if (right_in && !left_in && bindings.count(p_info.left.binding)) {
+                next = p_info.left.binding;
+            } else {
+                continue;
+            }
+            index_predicate = &p_info;
+            break;
+        }
+        // Cross products are not sampled
+        if (!index_predicate)
+            return false;
+
+        // Orient the predicates: (joined side, new side)
+        vector<pair<SelectInfo, SelectInfo>> checks;
+        for (auto &p_info : query.predicates()) {
+            if (p_info.left.binding == next && (slots.count(p_info.right.binding)
+                                                || p_info.right.binding == next))
+                checks.emplace_back(p_info.right, p_info.left);
+            else if (p_info.right.binding == next && slots.count(p_info.left.binding))
+                checks.emplace_back(p_info.left, p_info.right);
+        }
+        auto lookup = index_predicate->left.binding == next
+            ? make_pair(index_predicate->right, index_predicate->left)
+            : make_pair(index_predicate->left, index_predicate->right);
+
+        auto &relation = relations[rel_ids[next]];
+        auto &index = indexes_[rel_ids[next]][lookup.second.col_id];
+        auto &key = keys.at(next);
+        auto lookup_column = relations[rel_ids[lookup.first.binding]].columns()[lookup.first.col_id];
+        unsigned lookup_slot = slots.at(lookup.first.binding);
+        unsigned width = joined.size();
+
+        // The value of a column of a binding for a (partial) sampled tuple
+        auto value = [&](const uint64_t *tuple, const SelectInfo &column, uint64_t row) {
+            if (column.binding == next)
+                return relation.columns()[column.col_id][row];
+            return relations[rel_ids[column.binding]]
+                .columns()[column.col_id][tuple[slots.at(column.binding)]];
+        };
+
+        vector<uint64_t> extended;
+        uint64_t num_tuples = tuples.size() / width;
+        uint64_t processed = 0;
+        for (; processed < num_tuples; ++processed) {
+            if (processed % kDeadlineCheckInterval == 0 && omp_get_wtime() > deadline)
+                return false;
+            // Stop extending once enough tuples are found; the prefix of the
+            // (randomly ordered) tuples is extrapolated to all of them
+            if (extended.size() / (width + 1) >= 2 * JOIN_SAMPLE_CAP)
+                break;
+            const uint64_t *tuple = &tuples[processed * width];
+            auto range = index.equal_range(lookup_column[tuple[lookup_slot]]);
+            for (auto iter = range.first; iter != range.second; ++iter) {
+                uint64_t row = *iter;
+                if (!passes(relation, key, row))
+                    continue;
+                bool match = true;
+                for (auto &check : checks) {
+                    if (value(tuple, check.first, row) != value(tuple, check.second, row)) {
+                        match = false;
+                        break;
+                    }
+                }
+                if (!match)
+                    continue;
+                extended.insert(extended.end(), tuple, tuple + width);
+                extended.push_back(row);
+            }
+        }
+        scale *= 1.0 * num_tuples / processed;
+
+        slots.emplace(next, width);
+        joined.push_back(next);
+        ++width;
+        uint64_t num_extended = extended.size() / width;
+        if (num_extended == 0) {
+            // Less than a single sampled tuple
+            size = scale;
+            return false;
+        }
+
+        // Keep every k-th tuple to bound the work of the next step
+        if (num_extended > JOIN_SAMPLE_CAP) {
+            uint64_t stride = (num_extended + JOIN_SAMPLE_CAP - 1) / JOIN_SAMPLE_CAP;
+            uint64_t kept = 0;
+            for (uint64_t i = 0; i < num_extended; i += stride, ++kept)
+                copy(&extended[i * width], &extended[(i + 1) * width], &extended[kept * width]);
+            extended.resize(kept * width);
+            scale *= 1.0 * num_extended / kept;
+        }
+        tuples = move(extended);
+    }
+
+    size = scale * (tuples.size() / joined.size());
+    return true;
+}
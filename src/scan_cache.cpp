@@ -0,0 +1,139 @@
+#include "scan_cache.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+using namespace::std;
+
+// The constructor: normalize the filters into one range per column
+FilterKey::FilterKey(RelationId rel_id, const vector<FilterInfo> &filters)
+    : rel_id_(rel_id) {
+    map<unsigned, ColumnRange> ranges;
+    for (auto &f : filters) {
+        unsigned col_id = f.filter_column.col_id;
+        auto iter = ranges.emplace(col_id, ColumnRange(col_id)).first;
+        if (!iter->second.restrict(f))
+            unsatisfiable_ = true;
+    }
+    for (auto &entry : ranges)
+        ranges_.push_back(entry.second);
+}
+
+// Every tuple passing this key also passes the other key
+bool FilterKey::implies(const FilterKey &other) const {
+    if (rel_id_ != other.rel_id_)
+        return false;
+    if (unsatisfiable_)
+        return true;
+    auto mine = ranges_.begin();
+    for (auto &theirs : other.ranges_) {
+        while (mine != ranges_.end() && mine->col_id < theirs.col_id)
+            ++mine;
+        // Unconstrained column here but constrained in the other key
+        if (mine == ranges_.end() || mine->col_id != theirs.col_id)
+            return false;
+        if (!theirs.contains(*mine))
+            return false;
+    }
+    return true;
+}
+
+// Canonical text (relation id and ranges)
+string FilterKey::str() const {
+    stringstream ss;
+    ss << rel_id_ << '|';
+    if (unsatisfiable_) {
+        ss << "0";
+        return ss.str();
+    }
+    for (auto &range : ranges_)
+        ss << range.col_id << ':' << range.low << '-' << range.high << ',';
+    return ss.str();
+}
+
+// Evict least recently used entries until the budget is met
+void ScanCache::evict() {
+    while (used_ > budget_ && !lru_.empty()) {
+        auto &victim = lru_.back();
+        used_ -= victim.bytes;
+        index_.erase(victim.key.str());
+        auto &entries = by_relation_[victim.key.rel_id()];
+        entries.erase(find(entries.begin(), entries.end(), prev(lru_.end())));
+        if (entries.empty())
+            by_relation_.erase(victim.key.rel_id());
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+// Look up a filtered scan
+Selection ScanCache::lookup(const FilterKey &key, bool &exact) {
+    auto str = key.str();
+    lock_guard<mutex> lock(mutex_);
+    exact = false;
+
+    auto iter = index_.find(str);
+    if (iter != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        exact = true;
+        ++hits_;
+        return iter->second->ids;
+    }
+
+    // Find the smallest cached selection implied by the filters, e.g. cached
+    // "c2>3499" answers "c2>3999" or "c2>3499 and c1<7" after re-filtering.
+    // Only entries of the same relation are candidates
+    auto best = lru_.end();
+    auto candidates = by_relation_.find(key.rel_id());
+    if (candidates != by_relation_.end()) {
+        for (auto entry : candidates->second) {
+            if (key.implies(entry->key)
+                && (best == lru_.end() || entry->ids->size() < best->ids->size()))
+                best = entry;
+        }
+    }
+    if (best == lru_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, best);
+    ++partial_hits_;
+    return best->ids;
+}
+
+// Insert the selection of a filtered scan
+void ScanCache::insert(const FilterKey &key, Selection ids) {
+    auto str = key.str();
+    lock_guard<mutex> lock(mutex_);
+    if (index_.count(str))
+        return;
+    size_t bytes = ids->size() * sizeof(uint32_t) + sizeof(Entry)
+        + key.ranges().size() * sizeof(ColumnRange);
+    if (bytes > budget_)
+        return;
+    lru_.push_front(Entry{key, move(ids), bytes});
+    index_.emplace(move(str), lru_.begin());
+    by_relation_[key.rel_id()].push_back(lru_.begin());
+    used_ += bytes;
+    evict();
+}
+
+// Drop all entries
+void ScanCache::clear() {
+    lock_guard<mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    by_relation_.clear();
+    used_ = 0;
+}
+
+// Print statistics
+void ScanCache::report(ostream &out) {
+    lock_guard<mutex> lock(mutex_);
+    uint64_t lookups = hits_ + partial_hits_ + misses_;
+    out << "Scan cache: " << lookups << " lookups, " << hits_ << " hits, "
+        << partial_hits_ << " partial hits, " << evictions_ << " evictions, "
+        << lru_.size() << " entries, " << used_ / (1024.0 * 1024.0) << " MB"
+        << endl;
+}
@@ -0,0 +1,190 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+using namespace::std;
+
+namespace {
+
+/// Reads the words of a mapped snapshot, checking every access against its
+/// length
+class Reader {
+    private:
+        const char *data_;
+        size_t length_;
+        size_t offset_ = 0;
+
+    public:
+        Reader(const char *data, size_t length) : data_(data), length_(length) {}
+
+        /// The next count bytes (null if the snapshot is too short)
+        const char *take(uint64_t count) {
+            if (count > length_ - offset_)
+                return nullptr;
+            // Keep words aligned
+            count = (count + 7) & ~7ull;
+            if (count > length_ - offset_)
+                return nullptr;
+            const char *result = data_ + offset_;
+            offset_ += count;
+            return result;
+        }
+        /// The next word
+        bool word(uint64_t &value) {
+            auto p = take(sizeof(uint64_t));
+            if (p)
+                value = *reinterpret_cast<const uint64_t *>(p);
+            return p != nullptr;
+        }
+        /// The whole snapshot was read
+        bool done() const { return offset_ == length_; }
+};
+
+/// The fixed part of the snapshot of a column
+struct ColumnHeader {
+    uint64_t min, max, distinct, unique, interval_width, intervals, bloom_words;
+};
+
+// Write words
+void writeWords(ofstream &out, const uint64_t *words, uint64_t count) {
+    out.write(reinterpret_cast<const char *>(words), count * sizeof(uint64_t));
+}
+
+} // namespace
+
+// Hash of the contents of a relation
+uint64_t contentHash(const Relation &relation) {
+    auto &columns = relation.columns();
+    uint64_t size = relation.size();
+    vector<uint64_t> hashes(columns.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t c = 0; c < columns.size(); ++c) {
+        // Four independent lanes keep the multiplications pipelined
+        uint64_t lanes[4] = {c + 1, c + 2, c + 3, c + 4};
+        auto column = columns[c];
+        uint64_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            for (unsigned l = 0; l < 4; ++l)
+                lanes[l] = (lanes[l] ^ column[i + l]) * 0x9E3779B97F4A7C15ull;
+        }
+        for (; i < size; ++i)
+            lanes[0] = (lanes[0] ^ column[i]) * 0x9E3779B97F4A7C15ull;
+        uint64_t hash = 0;
+        for (auto lane : lanes)
+            hash = (hash ^ lane ^ (lane >> 29)) * 0xBF58476D1CE4E5B9ull;
+        hashes[c] = hash;
+    }
+    uint64_t hash = (size ^ (columns.size() << 48)) * 0x9E3779B97F4A7C15ull;
+    for (auto h : hashes)
+        hash = (hash ^ h ^ (hash >> 31)) * 0xBF58476D1CE4E5B9ull;
+    return hash;
+}
+
+// Store the snapshot of a relation
+bool Snapshot::store(const string &file_name, uint64_t hash,
+                     const RelationStatistics &statistics,
+                     const vector<ColumnIndex> &indexes) {
+    // Write a temporary file and rename it: a concurrent or interrupted run
+    // never sees a partial snapshot
+    string tmp_name = file_name + ".tmp";
+    ofstream out(tmp_name, ios::out | ios::binary | ios::trunc);
+    if (!out)
+        return false;
+
+    uint64_t header[] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, hash, statistics.size,
+                         statistics.columns.size()};
+    writeWords(out, header, 5);
+    for (auto &column : statistics.columns) {
+        auto &histogram = column.histogram;
+        ColumnHeader h{column.min, column.max, column.distinct, column.unique,
+                       histogram.get_interval_width(), histogram.get_number_of_intervals(),
+                       column.values.words().size()};
+        writeWords(out, reinterpret_cast<const uint64_t *>(&h), sizeof(h) / sizeof(uint64_t));
+    }
+    for (size_t c = 0; c < statistics.columns.size(); ++c) {
+        auto &column = statistics.columns[c];
+        vector<uint64_t> counts(column.histogram.get_interval_counts().begin(),
+                                column.histogram.get_interval_counts().end());
+        writeWords(out, counts.data(), counts.size());
+        writeWords(out, column.values.words().data(), column.values.words().size());
+        out.write(reinterpret_cast<const char *>(indexes[c].ids()),
+                  indexes[c].size() * sizeof(uint32_t));
+        if (indexes[c].size() % 2)
+            out.write("\0\0\0\0", 4);
+    }
+    out.close();
+    if (!out || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Map the snapshot of a relation
+bool Snapshot::load(const string &file_name, uint64_t hash, const Relation &relation,
+                    RelationStatistics &statistics, vector<ColumnIndex> &indexes) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat sb{};
+    if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t length = sb.st_size;
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    // The indexes share the mapping, which is unmapped with the last of them
+    shared_ptr<const char> mapping(static_cast<const char *>(addr),
+                                   [length](const char *p) { munmap(const_cast<char *>(p), length); });
+
+    Reader reader(mapping.get(), length);
+    uint64_t magic, version, snapshot_hash, size, num_columns;
+    if (!reader.word(magic) || !reader.word(version) || !reader.word(snapshot_hash)
+        || !reader.word(size) || !reader.word(num_columns))
+        return false;
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || snapshot_hash != hash
+        || size != relation.size() || num_columns != relation.columns().size())
+        return false;
+
+    auto headers = reinterpret_cast<const ColumnHeader *>(
+        reader.take(num_columns * sizeof(ColumnHeader)));
+    if (!headers)
+        return false;
+    RelationStatistics loaded_statistics;
+    loaded_statistics.size = size;
+    loaded_statistics.columns.resize(num_columns);
+    vector<ColumnIndex> loaded_indexes(num_columns);
+    for (uint64_t c = 0; c < num_columns; ++c) {
+        auto &h = headers[c];
+        auto counts = reinterpret_cast<const uint64_t *>(reader.take(h.intervals * sizeof(uint64_t)));
+        auto words = reinterpret_cast<const uint64_t *>(reader.take(h.bloom_words * sizeof(uint64_t)));
+        auto ids = reinterpret_cast<const uint32_t *>(reader.take(size * sizeof(uint32_t)));
+        if ((h.intervals && !counts) || (h.bloom_words && !words) || (size && !ids))
+            return false;
+
+        auto &column = loaded_statistics.columns[c];
+        column.min = h.min;
+        column.max = h.max;
+        column.distinct = h.distinct;
+        column.unique = h.unique;
+        column.histogram = Histogram(h.interval_width, vector<size_t>(counts, counts + h.intervals));
+        column.values.assign(vector<uint64_t>(words, words + h.bloom_words));
+        loaded_indexes[c].assign(relation.columns()[c], shared_ptr<const uint32_t>(mapping, ids), size);
+    }
+    if (!reader.done())
+        return false;
+
+    statistics = move(loaded_statistics);
+    indexes = move(loaded_indexes);
+    return true;
+}
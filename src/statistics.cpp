@@ -1,6 +1,7 @@
 #include "statistics.h"
 #include "omp.h"
-#include <limits.h>
+#include <algorithm>
+#include <limits>
 
 using namespace::std;
 
@@ -14,16 +15,20 @@ Histogram::Histogram(uint64_t interval_width, uint64_t estimated_histogram_max)
     this->interval_count = vector<size_t> (get_interval_index(estimated_histogram_max) + 1, 0);
 }
 
+Histogram::Histogram(uint64_t interval_width, vector<size_t> &&interval_count) {
+    this->interval_width = interval_width;
+    this->interval_count = move(interval_count);
+}
+
 void Histogram::add_entry(uint64_t entry) {
     size_t i_index = get_interval_index(entry);
     if (i_index + 1 > get_number_of_intervals()) {
         interval_count.resize(i_index + 1, 0);
-    } else {
-        interval_count[i_index] += 1;
     }
+    interval_count[i_index] += 1;
 }
 
-size_t Histogram::get_total_number_of_records() {
+size_t Histogram::get_total_number_of_records() const {
     size_t count = 0;
     size_t number_of_intervals = get_number_of_intervals();
     #pragma omp parallel for reduction (+: count)
@@ -33,7 +38,7 @@ size_t Histogram::get_total_number_of_records() {
     return count;
 }
 
-size_t Histogram::get_number_of_records_geq(uint64_t threshold) {
+size_t Histogram::get_number_of_records_geq(uint64_t threshold) const {
     if (threshold > get_histogram_max())
         return 0;
     size_t number_of_intervals = get_number_of_intervals();
@@ -54,14 +59,14 @@ size_t Histogram::get_number_of_records_geq(uint64_t threshold) {
     return sum;
 }
 
-size_t Histogram::get_number_of_records_gt(uint64_t threshold) {
-    if (threshold == UINT_MAX)
+size_t Histogram::get_number_of_records_gt(uint64_t threshold) const {
+    if (threshold == numeric_limits<uint64_t>::max())
         return 0;
     else
         return this->get_number_of_records_geq(threshold + 1);
 }
 
-size_t Histogram::get_number_of_records_leq(uint64_t threshold) {
+size_t Histogram::get_number_of_records_leq(uint64_t threshold) const {
     if (threshold >= get_histogram_max()) {
         return get_total_number_of_records();
     }
@@ -83,14 +88,14 @@ size_t Histogram::get_number_of_records_leq(uint64_t threshold) {
     return sum;
 }
 
-size_t Histogram::get_number_of_records_lt(uint64_t threshold) {
+size_t Histogram::get_number_of_records_lt(uint64_t threshold) const {
     if (threshold == 0)
         return 0;
     else
         return get_number_of_records_leq(threshold - 1);
 }
 
-size_t Histogram::get_number_of_records_geq_leq(uint64_t low, uint64_t high) {
+size_t Histogram::get_number_of_records_geq_leq(uint64_t low, uint64_t high) const {
 
     if (low > high)
         return 0;
@@ -128,23 +133,178 @@ size_t Histogram::get_number_of_records_geq_leq(uint64_t low, uint64_t high) {
     return sum;
 }
 
-size_t Histogram::get_number_of_records_geq_lt(uint64_t low, uint64_t high) {
+size_t Histogram::get_number_of_records_geq_lt(uint64_t low, uint64_t high) const {
     if (high == 0)
         return 0;
     else
         return get_number_of_records_geq_leq(low, high - 1);
 }
 
-size_t Histogram::get_number_of_records_gt_leq(uint64_t low, uint64_t high) {
-    if (low == UINT_MAX)
+size_t Histogram::get_number_of_records_gt_leq(uint64_t low, uint64_t high) const {
+    if (low == numeric_limits<uint64_t>::max())
         return 0;
     else
         return get_number_of_records_geq_leq(low + 1, high);
 }
 
-size_t Histogram::get_number_of_records_gt_lt(uint64_t low, uint64_t high) {
-    if (low == UINT_MAX || high == 0)
+size_t Histogram::get_number_of_records_gt_lt(uint64_t low, uint64_t high) const {
+    if (low == numeric_limits<uint64_t>::max() || high == 0)
         return 0;
     else
         return get_number_of_records_geq_leq(low + 1, high - 1);
-}
\ No newline at end of file
+}
+
+// The bit positions of a value
+void BloomFilter::positions(uint64_t value, uint64_t (&bits)[3]) const {
+    // Double hashing with the halves of a multiplicative hash
+    uint64_t hash = (value + 1) * 0x9E3779B97F4A7C15ull;
+    uint64_t h1 = hash >> 32, h2 = (hash & 0xFFFFFFFFull) | 1;
+    for (unsigned i = 0; i < 3; ++i)
+        bits[i] = (h1 + i * h2) & mask_;
+}
+
+// Build the filter of a set of values
+void BloomFilter::build(const uint64_t *values, uint64_t count, uint64_t distinct) {
+    if (distinct == 0)
+        distinct = count;
+    uint64_t num_bits = 64;
+    while (num_bits < distinct * BLOOM_FILTER_BITS_PER_VALUE)
+        num_bits <<= 1;
+    mask_ = num_bits - 1;
+    words_.assign(num_bits / 64, 0);
+    uint64_t bits[3];
+    for (uint64_t i = 0; i < count; ++i) {
+        positions(values[i], bits);
+        for (auto bit : bits)
+            words_[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+
+// Restore a filter from its bits
+void BloomFilter::assign(vector<uint64_t> &&words) {
+    words_ = move(words);
+    mask_ = words_.empty() ? 0 : words_.size() * 64 - 1;
+}
+
+// The value might occur
+bool BloomFilter::mayContain(uint64_t value) const {
+    if (words_.empty())
+        return true;
+    uint64_t bits[3];
+    positions(value, bits);
+    for (auto bit : bits) {
+        if (!(words_[bit >> 6] & (1ull << (bit & 63))))
+            return false;
+    }
+    return true;
+}
+
+// Collect the statistics of a column
+ColumnStatistics computeColumnStatistics(const uint64_t *column, uint64_t size,
+                                         const ColumnMetadata *metadata) {
+    ColumnStatistics stats;
+    if (size == 0)
+        return stats;
+
+    if (metadata) {
+        stats.min = metadata->min;
+        stats.max = metadata->max;
+        stats.distinct = metadata->distinct;
+        stats.unique = metadata->unique;
+        // Dense columns contain every value of their range
+        if (stats.max - stats.min + 1 != stats.distinct)
+            stats.values.build(column, size, stats.distinct);
+    } else {
+        vector<uint64_t> sorted(column, column + size);
+        sort(sorted.begin(), sorted.end());
+        stats.min = sorted.front();
+        stats.max = sorted.back();
+        stats.distinct = unique(sorted.begin(), sorted.end()) - sorted.begin();
+        stats.unique = stats.distinct == size;
+        // Dense columns contain every value of their range
+        if (stats.max - stats.min + 1 != stats.distinct)
+            stats.values.build(sorted.data(), stats.distinct);
+    }
+
+    uint64_t interval_width = stats.max / HISTOGRAM_INTERVALS + 1;
+    stats.histogram = Histogram(interval_width, stats.max);
+    for (uint64_t i = 0; i < size; ++i)
+        stats.histogram.add_entry(column[i]);
+    return stats;
+}
+
+// Collect the statistics of all columns of a relation (in parallel)
+RelationStatistics computeRelationStatistics(const Relation &relation) {
+    RelationStatistics stats;
+    stats.size = relation.size();
+    size_t num_cols = relation.columns().size();
+    stats.columns.resize(num_cols);
+    auto &metadata = relation.metadata();
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t c = 0; c < num_cols; ++c)
+        stats.columns[c] = computeColumnStatistics(relation.columns()[c], relation.size(),
+                                                   c < metadata.size() ? &metadata[c] : nullptr);
+    return stats;
+}
+
+// Find the columns whose values are all contained in a unique column
+void detectForeignKeys(const vector<Relation> &relations,
+                       vector<RelationStatistics> &statistics) {
+    for (RelationId ref_rel = 0; ref_rel < relations.size(); ++ref_rel) {
+        for (unsigned ref_col = 0; ref_col < statistics[ref_rel].columns.size(); ++ref_col) {
+            auto &ref = statistics[ref_rel].columns[ref_col];
+            if (!ref.unique || statistics[ref_rel].size == 0)
+                continue;
+
+            // Cheap necessary conditions first
+            vector<pair<RelationId, unsigned>> candidates;
+            for (RelationId rel = 0; rel < relations.size(); ++rel) {
+                for (unsigned col = 0; col < statistics[rel].columns.size(); ++col) {
+                    auto &stats = statistics[rel].columns[col];
+                    if ((rel == ref_rel && col == ref_col) || statistics[rel].size == 0)
+                        continue;
+                    if (stats.min >= ref.min && stats.max <= ref.max
+                        && stats.distinct <= ref.distinct)
+                        candidates.emplace_back(rel, col);
+                }
+            }
+            if (candidates.empty())
+                continue;
+
+            // Sorted key columns (known from their metadata) are searched in
+            // place
+            auto ref_column = relations[ref_rel].columns()[ref_col];
+            auto &ref_metadata = relations[ref_rel].metadata();
+            vector<uint64_t> sorted_keys;
+            if (ref_col >= ref_metadata.size() || !ref_metadata[ref_col].sorted) {
+                sorted_keys.assign(ref_column, ref_column + relations[ref_rel].size());
+                sort(sorted_keys.begin(), sorted_keys.end());
+                ref_column = sorted_keys.data();
+            }
+            const uint64_t *keys_begin = ref_column, *keys_end = ref_column + relations[ref_rel].size();
+
+            vector<char> contained(candidates.size());
+            #pragma omp parallel for schedule(dynamic)
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                auto &relation = relations[candidates[c].first];
+                auto column = relation.columns()[candidates[c].second];
+                uint64_t size = relation.size();
+                // Probe about a thousand values spread over the column before
+                // verifying all of them
+                uint64_t stride = max<uint64_t>(1, size / 1024);
+                bool all = true;
+                for (uint64_t i = 0; i < size && all; i += stride)
+                    all = binary_search(keys_begin, keys_end, column[i]);
+                for (uint64_t i = 0; i < size && all; ++i)
+                    all = binary_search(keys_begin, keys_end, column[i]);
+                contained[c] = all;
+            }
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                if (contained[c]) {
+                    statistics[candidates[c].first].columns[candidates[c].second]
+                        .references.emplace_back(ref_rel, ref_col);
+                }
+            }
+        }
+    }
+}
@@ -1,11 +1,13 @@
 #include "utils.h"
 
 #include <iostream>
+#include <sys/resource.h>
 
 static double filter_time = 0.0;
 static double join_prep_time = 0.0, self_join_prep_time = 0.0;
 static double join_materialization_time = 0.0, join_probing_time = 0.0, join_build_time = 0.0;
 static double self_join_materialization_time = 0.0, self_join_probing_time = 0.0;
+static double semi_join_time = 0.0, star_join_time = 0.0;
 static double check_sum_time = 0.0;
 static double total_time = 0.0;
 static double relation_reading_time = 0.0, relation_writing_time = 0.0;
@@ -42,6 +44,13 @@ void Utils::storeRelation(std::ofstream &out, Relation &r, unsigned i) {
 }
 
 
+// Page faults of the process so far
+void get_page_faults(long *minor, long *major) {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    *minor = usage.ru_minflt;
+    *major = usage.ru_majflt;
+}
 
 // Timer
 double * get_relation_reading_time() {
@@ -98,12 +107,23 @@ double * get_checksum_time() {
     return &check_sum_time;
 }
 
+
+double * get_semi_join_time() {
+    return &semi_join_time;
+}
+
+double * get_star_join_time() {
+    return &star_join_time;
+}
+
 void reset_time() {
     total_time = 0.0;
     filter_time = 0.0;
     self_join_prep_time = 0.0;
     self_join_probing_time = 0.0;
     self_join_materialization_time = 0.0;
+    semi_join_time = 0.0;
+    star_join_time = 0.0;
     join_prep_time = 0.0;
     join_probing_time = 0.0;
     join_build_time = 0.0;
@@ -117,7 +137,8 @@ void display_time() {
     double join_time = join_prep_time + join_probing_time + join_materialization_time + join_build_time;
     double self_join_time = self_join_prep_time + self_join_probing_time + self_join_materialization_time;
     double relation_time = relation_writing_time + relation_reading_time;
-    double tracked_time = filter_time + self_join_time + join_time + check_sum_time + relation_time;
+    double tracked_time = filter_time + self_join_time + semi_join_time + star_join_time + join_time
+        + check_sum_time + relation_time;
     cerr << endl;
     cerr << "Tracked time = " << tracked_time << " sec." << endl;
     cerr << "    FilterScan time = " << filter_time << " sec." << endl;
@@ -125,6 +146,8 @@ void display_time() {
     cerr << "        Preparation time = " << self_join_prep_time << " sec." << endl;
     cerr << "        Probing time = " << self_join_probing_time << " sec." << endl;
     cerr << "        Merge time = " << self_join_materialization_time << " sec." << endl;
+    cerr << "    SemiJoin time = " << semi_join_time << " sec." << endl;
+    cerr << "    StarJoin time = " << star_join_time << " sec." << endl;
     cerr << "    Join time = " << join_time << " sec." << endl;
     cerr << "        Preparation time = " << join_prep_time << " sec." << endl;
     cerr << "        Building time = " << join_build_time << " sec." << endl;
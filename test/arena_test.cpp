@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+
+#include "arena.h"
+
+namespace {
+
+TEST(Arena, ScopesRewind) {
+  Arena arena;
+  ASSERT_EQ(Arena::current(), nullptr);
+  void *first;
+  {
+    ArenaScope batch(&arena);
+    ASSERT_EQ(Arena::current(), &arena);
+    first = arena.allocate(100);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(first) % ARENA_ALIGNMENT, 0u);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(first) % ARENA_BLOCK_ALIGNMENT, 0u);
+
+    // The allocations of a nested scope are released at its exit
+    void *query_buffer;
+    {
+      ArenaScope query(&arena);
+      query_buffer = arena.allocate(1000);
+      ASSERT_NE(query_buffer, first);
+    }
+    {
+      ArenaScope query(&arena);
+      ASSERT_EQ(arena.allocate(1000), query_buffer);
+    }
+  }
+  ASSERT_EQ(Arena::current(), nullptr);
+
+  // The blocks stay mapped for the next batch
+  size_t mapped = arena.mapped();
+  ASSERT_GT(mapped, 0u);
+  {
+    ArenaScope batch(&arena);
+    ASSERT_EQ(arena.allocate(100), first);
+    // Allocations beyond a block get a block of their own
+    void *large = arena.allocate(ARENA_BLOCK_SIZE + 1);
+    ASSERT_NE(large, nullptr);
+    ASSERT_GT(arena.mapped(), mapped + ARENA_BLOCK_SIZE);
+  }
+}
+
+TEST(Arena, Vectors) {
+  Arena arena;
+  ArenaVector<uint64_t> heap_values(10, 7);
+  ASSERT_EQ(heap_values.get_allocator().arena_, nullptr);
+  {
+    ArenaScope scope(&arena);
+    ArenaVector<uint64_t> values(10, 7);
+    ASSERT_EQ(values.get_allocator().arena_, &arena);
+    values.resize(1000);
+    for (uint64_t i = 0; i < values.size(); ++i)
+      values[i] = i;
+    ASSERT_EQ(values[999], 999u);
+    ASSERT_EQ(heap_values, ArenaVector<uint64_t>(10, 7));
+  }
+}
+
+}
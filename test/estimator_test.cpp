@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "estimator.h"
+#include "joiner.h"
+#include "statistics.h"
+#include "utils.h"
+
+namespace {
+
+TEST(Estimator, Histogram) {
+  Histogram histogram(10, 99);
+  for (uint64_t v = 0; v < 100; ++v)
+    histogram.add_entry(v);
+  ASSERT_EQ(histogram.get_total_number_of_records(), 100u);
+  ASSERT_EQ(histogram.get_number_of_records_geq_leq(20, 39), 20u);
+  ASSERT_EQ(histogram.get_number_of_records_lt(50), 50u);
+  ASSERT_EQ(histogram.get_number_of_records_gt(89), 10u);
+
+  // Entries beyond the estimated maximum grow the histogram
+  histogram.add_entry(150);
+  ASSERT_EQ(histogram.get_total_number_of_records(), 101u);
+}
+
+TEST(Estimator, ColumnStatistics) {
+  std::vector<uint64_t> column{5, 3, 3, 9, 5, 5};
+  auto stats = computeColumnStatistics(column.data(), column.size());
+  ASSERT_EQ(stats.min, 3u);
+  ASSERT_EQ(stats.max, 9u);
+  ASSERT_EQ(stats.distinct, 3u);
+  ASSERT_EQ(stats.histogram.get_total_number_of_records(), column.size());
+}
+
+TEST(Estimator, ColumnStatisticsFromMetadata) {
+  // Sparse values: the Bloom filter is built from the unsorted column
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 1000; ++i)
+    column.push_back((i * 37) % 500 * 3);
+  auto metadata = computeColumnMetadata(column.data(), column.size());
+  auto stats = computeColumnStatistics(column.data(), column.size());
+  auto from_metadata = computeColumnStatistics(column.data(), column.size(), &metadata);
+  ASSERT_EQ(from_metadata.min, stats.min);
+  ASSERT_EQ(from_metadata.max, stats.max);
+  ASSERT_EQ(from_metadata.distinct, stats.distinct);
+  ASSERT_EQ(from_metadata.unique, stats.unique);
+  ASSERT_EQ(from_metadata.values.words(), stats.values.words());
+  ASSERT_EQ(from_metadata.histogram.get_interval_counts(), stats.histogram.get_interval_counts());
+}
+
+TEST(Estimator, BloomFilter) {
+  // Even values only: the odd ones are mostly rejected
+  std::vector<uint64_t> values;
+  for (uint64_t v = 0; v < 2000; v += 2)
+    values.push_back(v);
+  BloomFilter filter;
+  ASSERT_TRUE(filter.mayContain(1));
+  filter.build(values.data(), values.size());
+  unsigned false_positives = 0;
+  for (uint64_t v = 0; v < 2000; ++v) {
+    if (v % 2 == 0)
+      ASSERT_TRUE(filter.mayContain(v));
+    else
+      false_positives += filter.mayContain(v);
+  }
+  ASSERT_LT(false_positives, 50u);
+
+  // Dense columns do not need a filter
+  auto stats = computeColumnStatistics(values.data(), values.size());
+  ASSERT_GT(stats.values.memory(), 0u);
+  std::vector<uint64_t> dense{3, 4, 5, 4};
+  ASSERT_EQ(computeColumnStatistics(dense.data(), dense.size()).values.memory(), 0u);
+}
+
+TEST(Estimator, ProvesEmpty) {
+  Joiner joiner;
+  auto *c0 = new uint64_t[100], *c1 = new uint64_t[100];
+  for (unsigned i = 0; i < 100; ++i) {
+    c0[i] = 2 * i;
+    c1[i] = 1000 + i;
+  }
+  joiner.addRelation(Relation(100, {c0, c1}));
+  joiner.addRelation(Utils::createRelation(100, 2));
+  auto &estimator = joiner.estimator();
+  QueryInfo missing("0|0.0=7|0.1");
+  ASSERT_FALSE(estimator.provesEmpty(missing));
+  joiner.buildStatistics();
+
+  ASSERT_TRUE(estimator.provesEmpty(missing));
+  ASSERT_FALSE(estimator.provesEmpty(QueryInfo("0|0.0=8|0.1")));
+  // Outside [min, max]
+  ASSERT_TRUE(estimator.provesEmpty(QueryInfo("0|0.0>198|0.1")));
+  ASSERT_TRUE(estimator.provesEmpty(QueryInfo("0 1|0.0=1.0&1.1<5&0.1<1000|0.1")));
+  // Disjoint join columns
+  ASSERT_TRUE(estimator.provesEmpty(QueryInfo("0 1|0.1=1.0|1.1")));
+  ASSERT_FALSE(estimator.provesEmpty(QueryInfo("0 1|0.0=1.0|1.1")));
+  ASSERT_EQ(joiner.join(missing), "NULL\n");
+}
+
+TEST(Estimator, Keys) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(1000, 2));
+  joiner.addRelation(Utils::createRelation(100, 2));
+  // A column with duplicates
+  auto *c0 = new uint64_t[10];
+  for (unsigned i = 0; i < 10; ++i)
+    c0[i] = i % 5;
+  joiner.addRelation(Relation(10, {c0}));
+  joiner.buildStatistics();
+
+  auto &statistics = joiner.statistics();
+  ASSERT_TRUE(statistics[0].columns[0].unique);
+  ASSERT_FALSE(statistics[2].columns[0].unique);
+  ASSERT_TRUE(joiner.relations()[1].isUnique(1));
+  ASSERT_FALSE(joiner.relations()[2].isUnique(0));
+  // 0..99 and 0..4 are contained in 0..999, but not the other way round
+  auto &references = statistics[2].columns[0].references;
+  ASSERT_NE(std::find(references.begin(), references.end(), std::make_pair(0u, 1u)),
+            references.end());
+  ASSERT_TRUE(std::find(statistics[0].columns[0].references.begin(),
+                        statistics[0].columns[0].references.end(),
+                        std::make_pair(1u, 0u)) == statistics[0].columns[0].references.end());
+
+  // Joining with an unfiltered key relation keeps the size of the rest
+  auto &estimator = joiner.estimator();
+  QueryInfo query("2 0|0.0=1.0|0.0");
+  ASSERT_NEAR(estimator.estimate(query, {0, 1}), 10, 1e-9);
+}
+
+TEST(Estimator, FilteredStarOnKeys) {
+  // A fact relation joined with ten filtered dimensions on their keys: the
+  // key bounds of all subsets are computed once
+  const unsigned dimensions = 10;
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(10000, dimensions + 1));
+  for (unsigned d = 0; d < dimensions; ++d)
+    joiner.addRelation(Utils::createRelation(1000 + d, 2));
+  joiner.buildStatistics();
+
+  std::string relations = "0", predicates;
+  for (unsigned d = 1; d <= dimensions; ++d) {
+    relations += " " + std::to_string(d);
+    predicates += "0." + std::to_string(d) + "=" + std::to_string(d) + ".0&"
+        + std::to_string(d) + ".1<900&";
+  }
+  predicates.pop_back();
+  QueryInfo query(relations + "|" + predicates + "|0.0");
+  std::set<unsigned> bindings;
+  for (unsigned b = 0; b <= dimensions; ++b)
+    bindings.insert(b);
+  double size = joiner.estimator().estimate(query, bindings);
+  ASSERT_GT(size, 0.0);
+  ASSERT_LE(size, 1000.0);
+}
+
+TEST(Estimator, Estimates) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(1000, 3));
+  joiner.addRelation(Utils::createRelation(100, 2));
+  joiner.buildStatistics();
+  auto &estimator = joiner.estimator();
+  ASSERT_TRUE(estimator.ready());
+
+  // Uniform values 0..999
+  ASSERT_NEAR(estimator.selectivity(0, ColumnRange(1, 0, 499)), 0.5, 0.05);
+  ASSERT_NEAR(estimator.selectivity(0, ColumnRange(1, 7, 7)), 0.001, 1e-9);
+  ASSERT_EQ(estimator.selectivity(0, ColumnRange(1, 5000, 6000)), 0.0);
+
+  QueryInfo query("0 1|0.0=1.1&0.2<500|1.0");
+  ASSERT_NEAR(estimator.estimateScan(query, 0), 500, 50);
+  ASSERT_NEAR(estimator.estimateScan(query, 1), 100, 1e-9);
+  // Join of 500 and 100 tuples on unique keys
+  ASSERT_NEAR(estimator.estimate(query, {0, 1}), 100, 10);
+}
+
+TEST(Estimator, Explain) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(100, 3));
+  joiner.addRelation(Utils::createRelation(100, 3));
+  joiner.buildStatistics();
+  joiner.setExplain(true);
+
+  QueryInfo query("0 1|0.0=1.1&0.2>49|1.0");
+  testing::internal::CaptureStderr();
+  auto result = joiner.join(query);
+  auto explain = testing::internal::GetCapturedStderr();
+
+  ASSERT_NE(explain.find("EXPLAIN 0 1|0.0=1.1&0.2>49|1.0"), std::string::npos);
+  ASSERT_NE(explain.find("Checksum"), std::string::npos);
+  ASSERT_NE(explain.find("Join 0.0=1.1"), std::string::npos);
+  ASSERT_NE(explain.find("FilterScan 0 [0.2>49]"), std::string::npos);
+  ASSERT_NE(explain.find("actual: 50"), std::string::npos);
+}
+
+TEST(Estimator, AdaptiveReplanning) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(5000, 3));
+  joiner.addRelation(Utils::createRelation(5000, 3));
+  joiner.buildStatistics();
+
+  std::string text = "0 1 0 1|0.0=1.0&1.0=2.0&2.0=3.1&0.1<2500|0.0 3.2";
+  QueryInfo query(text);
+  auto expected = joiner.join(query);
+
+  // Every misestimate triggers re-planning; the result is unchanged. The
+  // sizes observed in the first run would make the estimates exact
+  joiner.feedback().clear();
+  joiner.setReplanFactor(1.0);
+  joiner.setExplain(true);
+  QueryInfo replanned(text);
+  testing::internal::CaptureStderr();
+  auto result = joiner.join(replanned);
+  auto explain = testing::internal::GetCapturedStderr();
+  ASSERT_EQ(result, expected);
+  ASSERT_NE(explain.find("REPLAN after"), std::string::npos);
+}
+
+}
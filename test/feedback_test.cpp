@@ -0,0 +1,58 @@
+#include "gtest/gtest.h"
+
+#include "feedback.h"
+#include "joiner.h"
+#include "utils.h"
+
+namespace {
+
+TEST(Feedback, Signature) {
+  QueryInfo query("0 1 2|0.0=1.1&1.0=2.2&1.2>10|0.0");
+  // Same sub-plan with other binding numbers and predicate order
+  QueryInfo renumbered("2 1 0|1.0=0.2&2.0=1.1&1.2>10|0.0");
+  ASSERT_EQ(CardinalityFeedback::signature(query, {0, 1}),
+            CardinalityFeedback::signature(renumbered, {1, 2}));
+  ASSERT_NE(CardinalityFeedback::signature(query, {0, 1}),
+            CardinalityFeedback::signature(query, {1, 2}));
+
+  // Other filters, other sub-plan
+  QueryInfo other_filter("0 1 2|0.0=1.1&1.0=2.2&1.2>11|0.0");
+  ASSERT_NE(CardinalityFeedback::signature(query, {0, 1}),
+            CardinalityFeedback::signature(other_filter, {0, 1}));
+}
+
+TEST(Feedback, RecordAndEvict) {
+  CardinalityFeedback feedback(2);
+  double actual;
+  ASSERT_FALSE(feedback.lookup("a", actual));
+  feedback.record("a", 100, 400);
+  ASSERT_TRUE(feedback.lookup("a", actual));
+  ASSERT_DOUBLE_EQ(actual, 400.0);
+
+  feedback.record("b", 10, 10);
+  feedback.record("c", 10, 10);
+  ASSERT_EQ(feedback.size(), 2u);
+  ASSERT_FALSE(feedback.lookup("a", actual));
+}
+
+TEST(Feedback, CorrectsRepeatedQueries) {
+  // All columns hold the same values: the filters are correlated
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(1000, 3));
+  joiner.addRelation(Utils::createRelation(1000, 3));
+  joiner.buildStatistics();
+  auto &estimator = joiner.estimator();
+
+  std::string text = "0 1|0.0=1.0&0.1<500&1.2>249|1.0";
+  QueryInfo query(text);
+  joiner.join(query);
+  ASSERT_GT(joiner.feedback().size(), 0u);
+
+  // Later queries with the same sub-plans get the actual sizes
+  QueryInfo repeated(text);
+  repeated.inferFilters();
+  ASSERT_NEAR(estimator.estimate(repeated, {0, 1}), 250, 1e-6);
+  ASSERT_NEAR(estimator.estimateScan(repeated, 0), 500, 1e-6);
+}
+
+}
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "gather.h"
+
+namespace {
+
+TEST(Gather, Strategies) {
+  // A column beyond GATHER_CACHED_COLUMN_BYTES: c[i] = 3 * i
+  uint64_t column_size = 4 * GATHER_CACHED_COLUMN_BYTES / sizeof(uint64_t);
+  std::vector<uint64_t> column(column_size);
+  for (uint64_t i = 0; i < column_size; ++i)
+    column[i] = 3 * i;
+
+  std::mt19937_64 rng(7);
+  auto random_ids = [&](uint64_t count, uint64_t limit) {
+    std::vector<uint64_t> ids(count);
+    for (auto &id : ids)
+      id = rng() % limit;
+    return ids;
+  };
+  auto check = [&](const std::vector<uint64_t> &ids, uint64_t size,
+                   GatherStrategy expected) {
+    // The same strategy and values with 32-bit row ids
+    std::vector<uint32_t> narrow_ids(ids.begin(), ids.end());
+    Gather<uint64_t> gather(ids.data(), ids.size(), size);
+    Gather<uint32_t> narrow_gather(narrow_ids.data(), narrow_ids.size(), size);
+    ASSERT_EQ(gather.strategy(), expected);
+    ASSERT_EQ(narrow_gather.strategy(), expected);
+    std::vector<uint64_t> out(ids.size()), narrow_out(ids.size());
+    gather.gather(column.data(), out.data());
+    narrow_gather.gather(column.data(), narrow_out.data());
+    for (uint64_t i = 0; i < ids.size(); ++i)
+      ASSERT_EQ(out[i], 3 * ids[i]);
+    ASSERT_EQ(out, narrow_out);
+  };
+
+  // Cached column
+  check(random_ids(1000, 1000), 1000, GatherStrategy::Direct);
+  // Sorted ids
+  auto sorted = random_ids(1000, column_size);
+  std::sort(sorted.begin(), sorted.end());
+  check(sorted, column_size, GatherStrategy::Direct);
+  // Unsorted ids (fewer than GATHER_PREFETCH_DISTANCE too)
+  check(random_ids(1000, column_size), column_size, GatherStrategy::Prefetch);
+  check(random_ids(5, column_size), column_size, GatherStrategy::Prefetch);
+}
+
+}
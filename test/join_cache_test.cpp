@@ -0,0 +1,157 @@
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "join_cache.h"
+#include "operators.h"
+#include "utils.h"
+
+namespace {
+
+SharedHashTable buildTable(const std::vector<uint64_t> &keys,
+                           uint64_t num_partitions) {
+  auto table = std::make_shared<JoinHashTable>();
+  table->build(keys.data(), keys.size(), num_partitions);
+  return table;
+}
+
+TEST(JoinCache, HashTable) {
+  std::vector<uint64_t> keys{5, 7, 5, 100, 3};
+  for (uint64_t num_partitions : {1u, 4u}) {
+    auto table = buildTable(keys, num_partitions);
+    ASSERT_EQ(table->size(), keys.size());
+    auto range = table->equal_range(5);
+    std::set<uint64_t> ids;
+    for (auto iter = range.first; iter != range.second; ++iter)
+      ids.insert(iter->second);
+    ASSERT_EQ(ids, (std::set<uint64_t>{0, 2}));
+    range = table->equal_range(6);
+    ASSERT_TRUE(range.first == range.second);
+  }
+}
+
+TEST(JoinCache, UniqueHashTable) {
+  // All keys fall into the same partition
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i)
+    keys.push_back(4 * i);
+  for (uint64_t num_partitions : {1u, 4u}) {
+    JoinHashTable table;
+    table.build(keys.data(), keys.size(), num_partitions, true);
+    ASSERT_TRUE(table.unique());
+    for (uint64_t i = 0; i < keys.size(); ++i) {
+      auto id = table.find(keys[i]);
+      ASSERT_NE(id, nullptr);
+      ASSERT_EQ(*id, i);
+      ASSERT_EQ(table.find(keys[i] + 1), nullptr);
+    }
+  }
+}
+
+TEST(JoinCache, HeavyHitters) {
+  // Key 7 holds half of the tuples, the other keys occur once
+  std::vector<uint64_t> keys(10000);
+  std::vector<uint64_t> heavy_ids;
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    keys[i] = i % 2 ? 7 : 1000 + i;
+    if (i % 2)
+      heavy_ids.push_back(i);
+  }
+  for (uint64_t num_partitions : {1u, 4u}) {
+    auto table = buildTable(keys, num_partitions);
+    ASSERT_EQ(table->num_heavy(), 1u);
+    // A single tagged entry refers to the ids of the heavy hitter
+    auto range = table->equal_range(7);
+    ASSERT_EQ(std::distance(range.first, range.second), 1);
+    ASSERT_TRUE(JoinHashTable::heavy(range.first->second));
+    std::vector<uint64_t> ids;
+    table->forEachMatch(7, [&](uint64_t id) { ids.push_back(id); });
+    ASSERT_EQ(ids, heavy_ids);
+
+    ids.clear();
+    table->forEachMatch(1000, [&](uint64_t id) { ids.push_back(id); });
+    ASSERT_EQ(ids, std::vector<uint64_t>{0});
+  }
+
+  // Without skew, no key is a heavy hitter
+  for (uint64_t i = 0; i < keys.size(); ++i)
+    keys[i] = i % 5000;
+  ASSERT_EQ(buildTable(keys, 1)->num_heavy(), 0u);
+}
+
+TEST(JoinCache, GetOrBuild) {
+  std::vector<uint64_t> keys{1, 2, 3};
+  unsigned builds = 0;
+  auto build = [&]() { ++builds; return buildTable(keys, 1); };
+
+  JoinTableCache cache;
+  auto key = JoinTableCache::key(0, 1, "");
+  auto first = cache.get(key, false, build);
+  auto second = cache.get(key, false, build);
+  ASSERT_EQ(first, second);
+  ASSERT_EQ(builds, 1u);
+  ASSERT_EQ(cache.hits(), 1u);
+  ASSERT_EQ(cache.misses(), 1u);
+  ASSERT_GT(cache.used(), 0u);
+
+  // Filtered inputs are only cached once they recur
+  auto filtered_key = JoinTableCache::key(0, 1, "0|1:5-10,");
+  for (unsigned i = 1; i < JOIN_TABLE_CACHE_MIN_USES; ++i)
+    cache.get(filtered_key, true, build);
+  ASSERT_EQ(cache.size(), 1u);
+  cache.get(filtered_key, true, build);
+  ASSERT_EQ(cache.size(), 2u);
+  unsigned builds_before = builds;
+  cache.get(filtered_key, true, build);
+  ASSERT_EQ(builds, builds_before);
+
+  // The request counts of keys seen once are bounded
+  for (unsigned i = 0; i <= JOIN_TABLE_CACHE_MAX_COUNTED; ++i)
+    cache.get(JoinTableCache::key(0, 1, std::to_string(i)), true, build);
+  ASSERT_LE(cache.counted(), JOIN_TABLE_CACHE_MAX_COUNTED);
+  ASSERT_EQ(cache.size(), 2u);
+}
+
+TEST(JoinCache, ConcurrentRequestsBuildOnce) {
+  std::vector<uint64_t> keys(10000);
+  for (uint64_t i = 0; i < keys.size(); ++i)
+    keys[i] = i % 100;
+  std::atomic<unsigned> builds{0};
+  auto build = [&]() {
+    ++builds;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return buildTable(keys, 1);
+  };
+
+  JoinTableCache cache;
+  auto key = JoinTableCache::key(3, 0, "");
+  std::vector<SharedHashTable> tables(4);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < tables.size(); ++t)
+    threads.emplace_back([&, t]() { tables[t] = cache.get(key, false, build); });
+  for (auto &thread : threads)
+    thread.join();
+
+  ASSERT_EQ(builds.load(), 1u);
+  for (auto &table : tables)
+    ASSERT_EQ(table, tables[0]);
+}
+
+TEST(JoinCache, JoinReusesTable) {
+  Relation r1 = Utils::createRelation(10, 2);
+  Relation r2 = Utils::createRelation(20, 2);
+  JoinTableCache cache;
+  for (unsigned i = 0; i < 2; ++i) {
+    PredicateInfo p_info(SelectInfo(0, 0, 1), SelectInfo(1, 1, 0));
+    Join join(std::make_unique<Scan>(r1, 0), std::make_unique<Scan>(r2, 1),
+              p_info, &cache);
+    join.require(SelectInfo(0, 0, 0));
+    join.run();
+    ASSERT_EQ(join.result_size(), r1.size());
+  }
+  ASSERT_EQ(cache.misses(), 1u);
+  ASSERT_EQ(cache.hits(), 1u);
+}
+
+}
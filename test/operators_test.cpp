@@ -1,3 +1,5 @@
+#include <sstream>
+
 #include "gtest/gtest.h"
 
 #include "joiner.h"
@@ -132,6 +134,287 @@ TEST_F(OperatorTest, Join) {
   }
 }
 
+TEST_F(OperatorTest, FilterOrder) {
+  // c0 = i, c1 = i % 2
+  unsigned num_tuples = 1000;
+  auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples];
+  for (unsigned i = 0; i < num_tuples; ++i) {
+    c0[i] = i;
+    c1[i] = i % 2;
+  }
+  Relation r(num_tuples, {c0, c1});
+  SelectInfo col0(0, 0, 0), col1(0, 0, 1);
+  {
+    // The filters on c0 become one range, evaluated first (9% vs 50%)
+    std::vector<FilterInfo> filters{
+        FilterInfo(col1, 1, FilterInfo::Comparison::Equal),
+        FilterInfo(col0, 100, FilterInfo::Comparison::Less),
+        FilterInfo(col0, 9, FilterInfo::Comparison::Greater)};
+    FilterScan scan(r, filters);
+    scan.require(col0);
+    scan.run();
+    ASSERT_EQ(scan.ranges(), (std::vector<ColumnRange>{ColumnRange(0, 10, 99),
+                                                       ColumnRange(1, 1, 1)}));
+    ASSERT_TRUE(scan.predicated());
+    ASSERT_EQ(scan.result_size(), 45u);
+    auto col = scan.getResults()[scan.resolve(col0)];
+    for (unsigned i = 0; i < scan.result_size(); ++i)
+      ASSERT_EQ(col[i], 11 + 2 * i);
+  }
+  {
+    // Almost no tuple passes: branches are predictable
+    std::vector<FilterInfo> filters{
+        FilterInfo(col1, 0, FilterInfo::Comparison::Equal),
+        FilterInfo(col0, 10, FilterInfo::Comparison::Less)};
+    FilterScan scan(r, filters);
+    scan.require(col0);
+    scan.run();
+    ASSERT_EQ(scan.ranges()[0].col_id, 0u);
+    ASSERT_FALSE(scan.predicated());
+    ASSERT_EQ(scan.result_size(), 5u);
+  }
+}
+
+TEST_F(OperatorTest, EmptyJoinInput) {
+  // No tuple passes the filter: the other input is not run
+  std::vector<FilterInfo> filters{
+      FilterInfo(SelectInfo(0, 0, 0), 100, FilterInfo::Comparison::Greater)};
+  auto right = std::make_unique<Scan>(r2, 1);
+  auto *right_ptr = right.get();
+  auto join = std::make_unique<Join>(std::make_unique<FilterScan>(r1, filters),
+                                     move(right), PredicateInfo(SelectInfo(0, 0, 1),
+                                                                SelectInfo(1, 1, 1)));
+  auto *join_ptr = join.get();
+  Checksum checksum(move(join), {SelectInfo(0, 0, 2), SelectInfo(1, 1, 0)});
+  checksum.run();
+  ASSERT_EQ(join_ptr->result_size(), 0u);
+  ASSERT_TRUE(right_ptr->skipped());
+  ASSERT_FALSE(join_ptr->skipped());
+  ASSERT_EQ(checksum.check_sums(), (std::vector<uint64_t>{0, 0}));
+
+  std::stringstream out;
+  checksum.explain(out);
+  ASSERT_NE(out.str().find("Scan 1  (estimated: ?, skipped)"), std::string::npos);
+}
+
+TEST_F(OperatorTest, MultiPredicateJoin) {
+  // c0 = i, c1 = i % 3
+  unsigned num_tuples = 10;
+  auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples];
+  for (unsigned i = 0; i < num_tuples; ++i) {
+    c0[i] = i;
+    c1[i] = i % 3;
+  }
+  Relation r(num_tuples, {c0, c1});
+
+  {
+    PredicateInfo p_info(SelectInfo(0, 0, 1), SelectInfo(0, 1, 1));
+    Join join(std::make_unique<Scan>(r, 0), std::make_unique<Scan>(r, 1), p_info);
+    join.run();
+    ASSERT_EQ(join.result_size(), 4u * 4u + 3u * 3u + 3u * 3u);
+  }
+  {
+    // The second predicate is checked during the probe (its sides are swapped)
+    std::vector<PredicateInfo> p_infos{
+        PredicateInfo(SelectInfo(0, 0, 1), SelectInfo(0, 1, 1)),
+        PredicateInfo(SelectInfo(0, 1, 0), SelectInfo(0, 0, 0))};
+    Join join(std::make_unique<Scan>(r, 0), std::make_unique<Scan>(r, 1), p_infos);
+    join.require(SelectInfo(0, 1, 0));
+    join.run();
+    ASSERT_EQ(join.result_size(), num_tuples);
+    auto results = join.getResults();
+    auto col = results[join.resolve(SelectInfo(0, 1, 0))];
+    uint64_t sum = 0;
+    for (unsigned i = 0; i < join.result_size(); ++i)
+      sum += col[i];
+    ASSERT_EQ(sum, 45u);
+  }
+}
+
+TEST_F(OperatorTest, UniqueKeyJoin) {
+  // c0 = 2 * i (a key), c1 = i % 4
+  unsigned num_tuples = 100;
+  auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples];
+  for (unsigned i = 0; i < num_tuples; ++i) {
+    c0[i] = 2 * i;
+    c1[i] = i % 4;
+  }
+  Relation keys(num_tuples, {c0, c1});
+  keys.setUnique(0, true);
+  ASSERT_TRUE(Scan(keys, 0).isUnique(SelectInfo(0, 0, 0)));
+  ASSERT_FALSE(Scan(keys, 0).isUnique(SelectInfo(0, 0, 1)));
+
+  // Join the keys with the values 0..199 of r (half of them find a key)
+  Relation r = Utils::createRelation(200, 2);
+  std::vector<PredicateInfo> p_infos{
+      PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0)),
+      PredicateInfo(SelectInfo(0, 0, 1), SelectInfo(1, 1, 1))};
+  for (unsigned residuals = 0; residuals < 2; ++residuals) {
+    std::vector<PredicateInfo> predicates(p_infos.begin(), p_infos.begin() + 1 + residuals);
+    Join join(std::make_unique<Scan>(keys, 0), std::make_unique<Scan>(r, 1), predicates);
+    join.require(SelectInfo(1, 1, 0));
+    join.run();
+    // The residual i % 4 == 2 * i only holds for i = 0
+    ASSERT_EQ(join.result_size(), residuals ? 1u : num_tuples);
+  }
+}
+
+TEST_F(OperatorTest, ProbeModes) {
+  // Keys 0..999 probed by 0..2002 (not a multiple of the group size)
+  Relation keys = Utils::createRelation(1000, 1);
+  keys.setUnique(0, true);
+  Relation r = Utils::createRelation(2003, 1);
+  std::vector<std::vector<uint64_t>> results;
+  for (auto mode : {ProbeMode::Simple, ProbeMode::GroupPrefetch}) {
+    Join join(std::make_unique<Scan>(keys, 0), std::make_unique<Scan>(r, 1),
+              PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0)));
+    join.setProbeMode(mode);
+    join.require(SelectInfo(1, 1, 0));
+    join.run();
+    ASSERT_EQ(join.result_size(), 1000u);
+    auto col = join.getResults()[join.resolve(SelectInfo(1, 1, 0))];
+    results.emplace_back(col, col + join.result_size());
+  }
+  ASSERT_EQ(results[0], results[1]);
+}
+
+TEST_F(OperatorTest, MorselOffsets) {
+  // Build keys i % 1000 (three tuples per key) probed by 0..49999: the probe
+  // spans several morsels and only its first 1000 tuples find matches
+  unsigned num_keys = 3000, num_probes = 50000;
+  auto *c0 = new uint64_t[num_keys];
+  for (unsigned i = 0; i < num_keys; ++i)
+    c0[i] = i % 1000;
+  Relation keys(num_keys, {c0});
+  Relation r = Utils::createRelation(num_probes, 1);
+
+  Join join(std::make_unique<Scan>(keys, 0), std::make_unique<Scan>(r, 1),
+            PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0)));
+  join.require(SelectInfo(0, 0, 0));
+  join.require(SelectInfo(1, 1, 0));
+  join.run();
+  ASSERT_EQ(join.result_size(), num_keys);
+  auto results = join.getResults();
+  auto left = results[join.resolve(SelectInfo(0, 0, 0))];
+  auto right = results[join.resolve(SelectInfo(1, 1, 0))];
+  // The matches are written in probe order
+  for (unsigned i = 0; i < join.result_size(); ++i) {
+    ASSERT_EQ(left[i], right[i]);
+    ASSERT_EQ(right[i], i / 3);
+  }
+}
+
+TEST_F(OperatorTest, SkewedJoin) {
+  // Build side: c0 = 3 for every other tuple, i otherwise; c1 = i % 7; c2 = i.
+  // Probe side: c0 = 3 for every third tuple, i otherwise; c1 = i % 5; c2 = i
+  unsigned build_size = 4000, probe_size = 30000;
+  auto *b0 = new uint64_t[build_size], *b1 = new uint64_t[build_size];
+  auto *b2 = new uint64_t[build_size];
+  for (unsigned i = 0; i < build_size; ++i) {
+    b0[i] = i % 2 ? 3 : i;
+    b1[i] = i % 7;
+    b2[i] = i;
+  }
+  auto *p0 = new uint64_t[probe_size], *p1 = new uint64_t[probe_size];
+  auto *p2 = new uint64_t[probe_size];
+  for (unsigned i = 0; i < probe_size; ++i) {
+    p0[i] = i % 3 ? i : 3;
+    p1[i] = i % 5;
+    p2[i] = i;
+  }
+  Relation build(build_size, {b0, b1, b2}), probe(probe_size, {p0, p1, p2});
+
+  std::vector<PredicateInfo> p_infos{
+      PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0)),
+      PredicateInfo(SelectInfo(0, 0, 1), SelectInfo(1, 1, 1))};
+  for (unsigned residuals = 0; residuals < 2; ++residuals) {
+    // The result size and the sums of the build and probe tuple ids
+    uint64_t expected_size = 0, expected_build_sum = 0, expected_probe_sum = 0;
+    for (unsigned j = 0; j < probe_size; ++j) {
+      for (unsigned i = 0; i < build_size; ++i) {
+        if (b0[i] == p0[j] && (!residuals || b1[i] == p1[j])) {
+          ++expected_size;
+          expected_build_sum += i;
+          expected_probe_sum += j;
+        }
+      }
+    }
+
+    std::vector<PredicateInfo> predicates(p_infos.begin(), p_infos.begin() + 1 + residuals);
+    Join join(std::make_unique<Scan>(build, 0), std::make_unique<Scan>(probe, 1), predicates);
+    join.require(SelectInfo(0, 0, 2));
+    join.require(SelectInfo(1, 1, 2));
+    join.run();
+    ASSERT_EQ(join.result_size(), expected_size);
+    auto results = join.getResults();
+    auto build_ids = results[join.resolve(SelectInfo(0, 0, 2))];
+    auto probe_ids = results[join.resolve(SelectInfo(1, 1, 2))];
+    uint64_t build_sum = 0, probe_sum = 0;
+    for (uint64_t i = 0; i < join.result_size(); ++i) {
+      build_sum += build_ids[i];
+      probe_sum += probe_ids[i];
+    }
+    ASSERT_EQ(build_sum, expected_build_sum);
+    ASSERT_EQ(probe_sum, expected_probe_sum);
+  }
+}
+
+TEST_F(OperatorTest, SemiJoin) {
+  // Keys 0..99 looked up by the values 0..199 of r
+  Relation keys = Utils::createRelation(100, 1);
+  keys.setUnique(0, true);
+  Relation r = Utils::createRelation(200, 2);
+  JoinTableCache cache;
+  for (unsigned i = 0; i < 2; ++i) {
+    SemiJoin semi_join(std::make_unique<Scan>(r, 1), SelectInfo(1, 1, 0), keys,
+                       SelectInfo(0, 0, 0), &cache);
+    semi_join.require(SelectInfo(1, 1, 1));
+    semi_join.run();
+    ASSERT_EQ(semi_join.result_size(), 100u);
+    auto col = semi_join.getResults()[semi_join.resolve(SelectInfo(1, 1, 1))];
+    for (unsigned j = 0; j < semi_join.result_size(); ++j)
+      ASSERT_EQ(col[j], j);
+  }
+  // The hash table of the keys is built once
+  ASSERT_EQ(cache.misses(), 1u);
+  ASSERT_EQ(cache.hits(), 1u);
+}
+
+TEST_F(OperatorTest, StarJoin) {
+  // Fact: c0 = i, c1 = i % 10 (0..99); keys 0..29; values 0..4 twice each
+  Relation fact = Utils::createRelation(100, 2);
+  for (unsigned i = 0; i < 100; ++i)
+    fact.columns()[1][i] = i % 10;
+  Relation keys = Utils::createRelation(30, 1);
+  keys.setUnique(0, true);
+  Relation values = Utils::createRelation(10, 1);
+  for (unsigned i = 0; i < 10; ++i)
+    values.columns()[0][i] = i % 5;
+
+  std::vector<std::unique_ptr<Operator>> dimensions;
+  dimensions.push_back(std::make_unique<Scan>(values, 2));
+  dimensions.push_back(std::make_unique<Scan>(keys, 1));
+  std::vector<PredicateInfo> p_infos{
+      PredicateInfo(SelectInfo(0, 0, 1), SelectInfo(2, 2, 0)),
+      PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0))};
+  StarJoin star(std::make_unique<Scan>(fact, 0), move(dimensions), p_infos);
+  star.require(SelectInfo(0, 0, 0));
+  star.require(SelectInfo(2, 2, 0));
+  star.run();
+
+  // Fact tuples below 30 with i % 10 < 5 find one key and two values
+  ASSERT_EQ(star.result_size(), 2u * 15u);
+  // The keys miss more fact tuples (70%) than the values (50%)
+  ASSERT_EQ(star.probe_order(), (std::vector<unsigned>{1, 0}));
+  auto results = star.getResults();
+  auto fact_col = results[star.resolve(SelectInfo(0, 0, 0))];
+  auto value_col = results[star.resolve(SelectInfo(2, 2, 0))];
+  for (unsigned i = 0; i < star.result_size(); ++i) {
+    ASSERT_LT(fact_col[i], 30u);
+    ASSERT_EQ(fact_col[i] % 10, value_col[i]);
+  }
+}
+
 TEST_F(OperatorTest, Checksum) {
   unsigned rel_binding = 5;
   Scan r1_scan(r1, rel_binding);
@@ -287,6 +570,224 @@ TEST_F(OperatorTest, Joiner) {
     auto result = joiner.join(i);
     ASSERT_EQ(result, "2\n");
   }
+  {
+    // Two predicates between the same relations
+    auto query = "0 1 2|0.0=1.1&1.2=2.0&0.1=1.0&2.1=1.1|1.0";
+    QueryInfo i(query);
+    auto result = joiner.join(i);
+    ASSERT_EQ(result, expSumWithoutFilters + "\n");
+  }
+  {
+    // Contradictory filters across a join predicate
+    auto query = "0 1|0.0=1.1&0.0>5&1.1<3|1.0 0.1";
+    QueryInfo i(query);
+    auto result = joiner.join(i);
+    ASSERT_EQ(result, "NULL NULL\n");
+  }
+}
+
+TEST_F(OperatorTest, SharedResult) {
+  PredicateInfo p_info(SelectInfo(0, 0, 1), SelectInfo(0, 1, 2));
+  std::shared_ptr<Operator> producer = std::make_shared<Join>(
+      std::make_unique<Scan>(r1, 0), std::make_unique<Scan>(r1, 1), p_info);
+  producer->require(SelectInfo(0, 0, 0));
+  producer->run();
+
+  // Bindings 3 and 4 of another query map to bindings 0 and 1
+  SharedResult shared(producer, {{3, 0}, {4, 1}});
+  ASSERT_TRUE(shared.require(SelectInfo(0, 3, 0)));
+  ASSERT_FALSE(shared.require(SelectInfo(0, 5, 0)));
+  shared.run();
+  ASSERT_EQ(shared.result_size(), r1.size());
+  auto results = shared.getResults();
+  ASSERT_EQ(results.size(), 1ull);
+  ASSERT_EQ(results[shared.resolve(SelectInfo(0, 3, 0))],
+            producer->getResults()[producer->resolve(SelectInfo(0, 0, 0))]);
+}
+
+TEST_F(OperatorTest, JoinerBatch) {
+  Joiner joiner;
+  unsigned num_tuples = 10;
+  for (unsigned i = 0; i < 5; i++) {
+    joiner.addRelation(Utils::createRelation(num_tuples, 3));
+  }
+
+  std::vector<std::string> raw_queries{
+      "0 1 2|0.0=1.1&1.2=2.0&1.1>4|1.0 2.2",
+      // Same join of 0 and 1 with different bindings and sides
+      "2 1 0|1.1=2.0&1.2=0.0&1.1>4|0.2",
+      "0 1|0.0=1.1&1.1>4|0.1",
+      // Same relations, different filter: not shared with the above
+      "0 1|0.0=1.1&1.1>5|0.1 1.0",
+      "0 1 3|0.0=1.1&0.0=1.2&1.2=2.0|2.1",
+      "0 1 3|0.0=1.1&1.2=2.0&0.0<3|0.1 2.1"};
+  std::vector<QueryInfo> batch;
+  std::vector<std::string> expected;
+  for (auto &raw : raw_queries) {
+    QueryInfo i(raw);
+    expected.push_back(joiner.join(i));
+    batch.emplace_back(raw);
+  }
+
+  auto results = joiner.joinBatch(batch);
+  ASSERT_EQ(results, expected);
+}
+
+TEST_F(OperatorTest, KeyLookups) {
+  // Keys 0..999, and c0 = i (half of them keys), c1 = i % 500 (all keys)
+  unsigned num_tuples = 2000;
+  auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples];
+  for (unsigned i = 0; i < num_tuples; ++i) {
+    c0[i] = i;
+    c1[i] = i % 500;
+  }
+  Joiner joiner, reference;
+  joiner.addRelation(Utils::createRelation(1000, 2));
+  joiner.addRelation(Relation(num_tuples, {c0, c1}));
+  reference.addRelation(Utils::createRelation(1000, 2));
+  reference.addRelation(Utils::createRelation(num_tuples, 2));
+  for (unsigned i = 0; i < num_tuples; ++i) {
+    reference.relations()[1].columns()[1][i] = i % 500;
+  }
+  joiner.buildStatistics();
+  joiner.setExplain(true);
+
+  for (auto text : {"0 1|0.0=1.1|1.0",          // the keys are dropped
+                    "0 1|0.0=1.0|1.1",          // semi-join
+                    "0 1|0.0=1.0&0.0>499|1.1",  // filtered keys: semi-join
+                    "0 1|0.0=1.0&1.0<500|1.1",  // implied filters: dropped
+                    "0 1|0.0=1.0&0.1>499|1.1",  // filters on other columns
+                    "0 1 0|0.0=1.1&1.0=2.0|1.0 0.1"}) {
+    QueryInfo query(text), reference_query(text);
+    ASSERT_EQ(joiner.join(query), reference.join(reference_query)) << text;
+  }
+}
+
+TEST_F(OperatorTest, BushyPlan) {
+  // c0 = i (a key), c1 = i % 10, c2 = i % 100
+  auto createRelation = []() {
+    unsigned num_tuples = 1000;
+    auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples],
+         *c2 = new uint64_t[num_tuples];
+    for (unsigned i = 0; i < num_tuples; ++i) {
+      c0[i] = i;
+      c1[i] = i % 10;
+      c2[i] = i % 100;
+    }
+    return Relation(num_tuples, {c0, c1, c2});
+  };
+  Joiner joiner, reference;
+  joiner.addRelation(createRelation());
+  reference.addRelation(createRelation());
+  joiner.buildStatistics();
+  joiner.setExplain(true);
+
+  // A chain of two small pairs connected by a join on c1 that multiplies
+  // each side by 100: the pairs are joined first
+  auto text = "0 0 0 0|0.0=1.0&1.1=2.1&2.0=3.0&0.0<10&3.2<10|0.0 2.0 3.2";
+  QueryInfo query(text), reference_query(text);
+  testing::internal::CaptureStderr();
+  auto result = joiner.join(query);
+  auto explain = testing::internal::GetCapturedStderr();
+  ASSERT_EQ(result, reference.join(reference_query));
+
+  std::stringstream lines(explain);
+  std::string line, root_join;
+  unsigned child_joins = 0;
+  while (std::getline(lines, line)) {
+    auto depth = line.find_first_not_of(' ');
+    if (line.compare(depth, 5, "Join ") != 0)
+      continue;
+    if (root_join.empty())
+      root_join = line;
+    else if (depth == root_join.find_first_not_of(' ') + 2)
+      ++child_joins;
+  }
+  ASSERT_EQ(child_joins, 2u) << explain;
+}
+
+TEST_F(OperatorTest, KeyLookupsInJoinedInputs) {
+  // c0 = i (a key), c1 = i % 10, c2 = 2000 + i % 100 (not a key)
+  auto createRelation = []() {
+    unsigned num_tuples = 1000;
+    auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples],
+         *c2 = new uint64_t[num_tuples];
+    for (unsigned i = 0; i < num_tuples; ++i) {
+      c0[i] = i;
+      c1[i] = i % 10;
+      c2[i] = 2000 + i % 100;
+    }
+    return Relation(num_tuples, {c0, c1, c2});
+  };
+  Joiner joiner, reference;
+  joiner.addRelation(createRelation());
+  reference.addRelation(createRelation());
+  joiner.buildStatistics();
+
+  // Binding 0 only looks up a filtered key: binding 1 is semi-joined before
+  // the star join reads it, but not again when the star join result is read
+  auto text = "0 0 0 0|0.0=1.0&1.1=2.1&2.0=3.0&0.0<10&3.2<2010|3.2 2.0";
+  QueryInfo query(text), reference_query(text);
+  ASSERT_EQ(joiner.join(query), reference.join(reference_query));
+}
+
+TEST_F(OperatorTest, NestedParallelInputs) {
+  // ((A join B) join (C join D)) join ((E join F) join (G join H)) with the
+  // inputs of the top two levels run concurrently: the innermost regions run
+  // with smaller teams than requested
+  const uint64_t num_tuples = 8000;
+  std::vector<Relation> relations;
+  for (unsigned r = 0; r < 8; ++r)
+    relations.push_back(Utils::createRelation(num_tuples, 2));
+
+  auto leaf = [&](unsigned binding) -> std::unique_ptr<Operator> {
+    // c1 < 6000 (a parallel filtered scan)
+    std::vector<FilterInfo> filters{
+        FilterInfo(SelectInfo(binding, binding, 1), 6000, FilterInfo::Comparison::Less)};
+    return std::make_unique<FilterScan>(relations[binding], filters);
+  };
+  auto join = [](std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                 unsigned left_binding, unsigned right_binding, bool parallel_inputs) {
+    auto result = std::make_unique<Join>(
+        std::move(left), std::move(right),
+        PredicateInfo(SelectInfo(left_binding, left_binding, 0),
+                      SelectInfo(right_binding, right_binding, 0)));
+    result->setParallelInputs(parallel_inputs);
+    return result;
+  };
+  auto pair = [&](unsigned b) { return join(leaf(b), leaf(b + 1), b, b + 1, false); };
+  auto root = join(join(pair(0), pair(2), 0, 2, true),
+                   join(pair(4), pair(6), 4, 6, true), 0, 4, true);
+  Checksum checksum(std::move(root), {SelectInfo(0, 0, 0), SelectInfo(7, 7, 1)});
+  checksum.run();
+
+  // Every tuple below 6000 joins with its partners
+  uint64_t expected_sum = 6000 * 5999 / 2;
+  ASSERT_EQ(checksum.result_size(), 6000u);
+  ASSERT_EQ(checksum.check_sums(), (std::vector<uint64_t>{expected_sum, expected_sum}));
+}
+
+TEST_F(OperatorTest, StarQuery) {
+  // Fact: c0 = i, c1 = i % 100, c2 = i % 7; dimensions: keys 0..99
+  Joiner joiner, reference;
+  for (auto *j : {&joiner, &reference}) {
+    j->addRelation(Utils::createRelation(10000, 3));
+    j->addRelation(Utils::createRelation(100, 2));
+    for (unsigned i = 0; i < 10000; ++i) {
+      j->relations()[0].columns()[1][i] = i % 100;
+      j->relations()[0].columns()[2][i] = i % 7;
+    }
+  }
+  joiner.buildStatistics();
+  joiner.setExplain(true);
+
+  auto text = "0 1 1|0.1=1.0&0.2=2.0&1.1<50&2.1>2|0.0 1.1 2.1";
+  QueryInfo query(text), reference_query(text);
+  testing::internal::CaptureStderr();
+  auto result = joiner.join(query);
+  auto explain = testing::internal::GetCapturedStderr();
+  ASSERT_EQ(result, reference.join(reference_query));
+  ASSERT_NE(explain.find("StarJoin 0.1=1.0&0.2=2.0"), std::string::npos) << explain;
 }
 
 }
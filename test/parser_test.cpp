@@ -173,3 +173,34 @@ TEST(Parser, DumpText) {
 
   ASSERT_EQ(i.dumpText(), raw_query);
 }
+
+TEST(Parser, InferFilters) {
+  {
+    // The filter on 0.1 also holds for 1.2 and (transitively) 2.0
+    QueryInfo i("0 1 2|0.1=1.2&1.2=2.0&0.1>3000|0.0");
+    ASSERT_TRUE(i.inferFilters());
+    ASSERT_EQ(i.dumpText(),
+              "0 1 2|0.1=1.2&1.2=2.0&0.1>3000&1.2>3000&2.0>3000|0.0");
+  }
+  {
+    // Ranges and constant equalities are merged per class
+    QueryInfo i("0 1|0.1=1.2&0.1>3000&1.2<4000&0.0=7&0.0<9|0.0");
+    ASSERT_TRUE(i.inferFilters());
+    ASSERT_EQ(i.dumpText(),
+              "0 1|0.1=1.2&0.0=7&0.1>3000&0.1<4000&1.2>3000&1.2<4000|0.0");
+  }
+  {
+    QueryInfo i("0 1|0.1=1.2&0.1=5&1.2=5|0.0");
+    ASSERT_TRUE(i.inferFilters());
+    ASSERT_EQ(i.dumpText(), "0 1|0.1=1.2&0.1=5&1.2=5|0.0");
+  }
+  {
+    // Contradictory ranges across a join predicate
+    QueryInfo i("0 1|0.1=1.2&0.1>5000&1.2<3000|0.0");
+    ASSERT_FALSE(i.inferFilters());
+  }
+  {
+    QueryInfo i("0 1|0.1=1.2&0.0=5&0.0=6|0.0");
+    ASSERT_FALSE(i.inferFilters());
+  }
+}
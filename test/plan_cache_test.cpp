@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "plan_cache.h"
+#include "utils.h"
+
+namespace {
+
+TEST(PlanCache, Template) {
+  QueryInfo query("3 0 1|0.2=1.0&0.1=2.0&0.2>3499|1.2 0.1");
+  QueryInfo other_constant("3 0 1|0.2=1.0&0.1=2.0&0.2>17|1.0 0.2");
+  QueryInfo other_comparison("3 0 1|0.2=1.0&0.1=2.0&0.2<3499|1.2 0.1");
+  QueryInfo other_relations("3 0 2|0.2=1.0&0.1=2.0&0.2>3499|1.2 0.1");
+  // Key lookups depend on the selected bindings
+  QueryInfo other_selections("3 0 1|0.2=1.0&0.1=2.0&0.2>3499|1.2");
+  ASSERT_EQ(PlanCache::key(query), PlanCache::key(other_constant));
+  ASSERT_NE(PlanCache::key(query), PlanCache::key(other_comparison));
+  ASSERT_NE(PlanCache::key(query), PlanCache::key(other_relations));
+  ASSERT_NE(PlanCache::key(query), PlanCache::key(other_selections));
+}
+
+TEST(PlanCache, SelectivityThreshold) {
+  PlanCache cache(2, 2.0);
+  std::vector<unsigned> order;
+  ASSERT_FALSE(cache.lookup("a", {100, 10}, order));
+  cache.insert("a", CachedPlan{{1, 0}, {100, 10}});
+  ASSERT_TRUE(cache.lookup("a", {150, 6}, order));
+  ASSERT_EQ(order, (std::vector<unsigned>{1, 0}));
+  // An estimate changed by more than the factor
+  ASSERT_FALSE(cache.lookup("a", {100, 30}, order));
+  ASSERT_EQ(cache.hits(), 1u);
+  ASSERT_EQ(cache.misses(), 1u);
+  ASSERT_EQ(cache.rejections(), 1u);
+
+  cache.insert("b", CachedPlan{{0}, {1}});
+  cache.insert("c", CachedPlan{{0}, {1}});
+  ASSERT_EQ(cache.size(), 2u);
+  ASSERT_FALSE(cache.lookup("a", {100, 10}, order));
+}
+
+TEST(PlanCache, JoinerReusesPlans) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(1000, 3));
+  joiner.addRelation(Utils::createRelation(2000, 3));
+  joiner.addRelation(Utils::createRelation(3000, 3));
+  joiner.buildStatistics();
+  auto &cache = joiner.plan_cache();
+
+  QueryInfo first("0 1 2|0.0=1.1&1.0=2.2&2.1>100|0.0");
+  ASSERT_EQ(joiner.join(first), "494450\n");
+  QueryInfo similar("0 1 2|0.0=1.1&1.0=2.2&2.1>150|0.0");
+  ASSERT_EQ(joiner.join(similar), "488175\n");
+  ASSERT_EQ(cache.hits(), 1u);
+
+  // Far more selective: planned again
+  QueryInfo selective("0 1 2|0.0=1.1&1.0=2.2&2.1>2900|0.0");
+  joiner.join(selective);
+  ASSERT_EQ(cache.rejections(), 1u);
+}
+
+TEST(PlanCache, ReusedTreeWithEliminatedBindings) {
+  // c0 = i (a key), c1 = i % 10, c2 = 2000 + i % 100
+  auto createRelation = []() {
+    unsigned num_tuples = 1000;
+    auto *c0 = new uint64_t[num_tuples], *c1 = new uint64_t[num_tuples],
+         *c2 = new uint64_t[num_tuples];
+    for (unsigned i = 0; i < num_tuples; ++i) {
+      c0[i] = i;
+      c1[i] = i % 10;
+      c2[i] = 2000 + i % 100;
+    }
+    return Relation(num_tuples, {c0, c1, c2});
+  };
+  Joiner joiner, reference;
+  joiner.addRelation(createRelation());
+  reference.addRelation(createRelation());
+  joiner.buildStatistics();
+
+  // The first query plans a bushy tree over all bindings; without the
+  // selection of binding 0 it only looks up a key and is no input
+  for (auto text : {"0 0 0 0|0.0=1.0&1.1=2.1&2.0=3.0&0.0<10&3.2<2010|0.0 2.0 3.2",
+                    "0 0 0 0|0.0=1.0&1.1=2.1&2.0=3.0&0.0<10&3.2<2010|2.0 3.2"}) {
+    QueryInfo query(text), reference_query(text);
+    ASSERT_EQ(joiner.join(query), reference.join(reference_query)) << text;
+  }
+}
+
+}
@@ -26,6 +26,53 @@ TEST(Relation, LoadAndStore) {
     ASSERT_RELATION_EQ(r1, r2);
 }
 
+TEST(Relation, LoadModes) {
+    Relation r1 = Utils::createRelation(1000, 5);
+
+    r1.storeRelation("r1");
+    for (auto mode : {LoadMode::Lazy, LoadMode::Populate, LoadMode::Copy}) {
+        Relation r2("r1", mode);
+        ASSERT_RELATION_EQ(r1, r2);
+        // Moving a relation keeps its memory mapped
+        Relation r3(std::move(r2));
+        ASSERT_RELATION_EQ(r1, r3);
+    }
+}
+
+TEST(Relation, FormatV2) {
+    // Column 0 is sorted and unique, column 1 holds ten values
+    std::vector<uint64_t *> columns{new uint64_t[1000], new uint64_t[1000]};
+    for (uint64_t i = 0; i < 1000; ++i) {
+        columns[0][i] = 2 * i + 1;
+        columns[1][i] = (i * 7) % 10 + 5;
+    }
+    Relation r1(1000, std::move(columns));
+
+    r1.storeRelation("r1", RelationFormat::V2);
+    for (auto mode : {LoadMode::Lazy, LoadMode::Copy}) {
+        Relation r2("r1", mode);
+        ASSERT_RELATION_EQ(r1, r2);
+        ASSERT_EQ(r2.metadata().size(), 2u);
+        auto &key = r2.metadata()[0], &value = r2.metadata()[1];
+        ASSERT_EQ(key.min, 1u);
+        ASSERT_EQ(key.max, 1999u);
+        ASSERT_EQ(key.distinct, 1000u);
+        ASSERT_TRUE(key.sorted && key.unique);
+        ASSERT_TRUE(r2.isUnique(0));
+        ASSERT_EQ(value.min, 5u);
+        ASSERT_EQ(value.max, 14u);
+        ASSERT_EQ(value.distinct, 10u);
+        ASSERT_FALSE(value.sorted || value.unique);
+        ASSERT_FALSE(r2.isUnique(1));
+    }
+
+    // Back to version 1: no metadata
+    Relation("r1").storeRelation("r1_v1");
+    Relation r3("r1_v1");
+    ASSERT_RELATION_EQ(r1, r3);
+    ASSERT_TRUE(r3.metadata().empty());
+}
+
 TEST(Relation, EmptyRelation) {
     Relation r1 = Utils::createRelation(0, 0);
 
@@ -71,3 +118,10 @@ TEST(Relation, CreateSQL) {
     ASSERT_FALSE(std::getline(infile, line));
 }
 
+
+TEST(Relation, RowIdDispatch) {
+  auto width = [](auto row_id) { return sizeof(row_id); };
+  ASSERT_EQ(dispatchRowId(0, width), sizeof(uint32_t));
+  ASSERT_EQ(dispatchRowId(NARROW_ROW_ID_LIMIT - 1, width), sizeof(uint32_t));
+  ASSERT_EQ(dispatchRowId(NARROW_ROW_ID_LIMIT, width), sizeof(uint64_t));
+}
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "sampling.h"
+#include "utils.h"
+
+namespace {
+
+TEST(Sampling, ColumnIndex) {
+  std::vector<uint64_t> column{5, 3, 3, 9, 5, 5};
+  ColumnIndex index;
+  index.build(column.data(), column.size());
+  auto range = index.equal_range(5);
+  std::set<uint32_t> ids(range.first, range.second);
+  ASSERT_EQ(ids, (std::set<uint32_t>{0, 4, 5}));
+  range = index.equal_range(4);
+  ASSERT_EQ(range.first, range.second);
+}
+
+TEST(Sampling, CorrelatedFilters) {
+  // All columns hold the same values
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(10000, 3));
+  joiner.addRelation(Utils::createRelation(10000, 3));
+  joiner.buildStatistics();
+  auto &estimator = joiner.estimator();
+
+  QueryInfo query("0 1|0.0=1.0&0.1<5000&0.2<5000|1.0");
+  // Independence assumption: 10000 * 0.5 * 0.5
+  ASSERT_NEAR(estimator.estimateScan(query, 0), 2500, 300);
+
+  SamplingEstimator sampler;
+  sampler.build(joiner.relations());
+  double size;
+  ASSERT_TRUE(sampler.estimateScan(query, 0, size));
+  ASSERT_NEAR(size, 5000, 800);
+  ASSERT_TRUE(sampler.estimate(query, {0, 1}, 1e100, size));
+  ASSERT_NEAR(size, 5000, 800);
+}
+
+TEST(Sampling, CorrelatedJoin) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(10000, 3));
+  joiner.addRelation(Utils::createRelation(10000, 3));
+  joiner.buildStatistics();
+
+  // The filters select disjoint key ranges: the join is empty
+  QueryInfo query("0 1|0.0=1.0&0.1<5000&1.2>4999|1.0");
+  SamplingEstimator sampler;
+  sampler.build(joiner.relations());
+  double size;
+  ASSERT_FALSE(sampler.estimate(query, {0, 1}, 1e100, size));
+  ASSERT_LT(size, 100);
+
+  // Planning the query uses the samples
+  CardinalityEstimator estimator(joiner.statistics());
+  estimator.setSampler(&sampler);
+  ASSERT_GT(estimator.estimate(query, {0, 1}), 1000);
+  estimator.startQuery(query);
+  ASSERT_LT(estimator.estimate(query, {0, 1}), 100);
+}
+
+TEST(Sampling, ThreeWayJoin) {
+  Joiner joiner;
+  joiner.addRelation(Utils::createRelation(5000, 2));
+  joiner.addRelation(Utils::createRelation(20000, 2));
+  joiner.buildStatistics();
+
+  QueryInfo query("0 1 1|0.0=1.0&1.1=2.1&2.0<2500|0.0");
+  SamplingEstimator sampler;
+  sampler.build(joiner.relations());
+  double size;
+  ASSERT_TRUE(sampler.estimate(query, {0, 1, 2}, 1e100, size));
+  ASSERT_NEAR(size, 2500, 400);
+
+  // No time left: no estimate
+  ASSERT_FALSE(sampler.estimate(query, {0, 1, 2}, 0.0, size));
+}
+
+}
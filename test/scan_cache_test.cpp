@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#include "operators.h"
+#include "scan_cache.h"
+#include "utils.h"
+
+namespace {
+
+FilterInfo makeFilter(unsigned col_id, uint64_t constant,
+                      FilterInfo::Comparison comparison) {
+  return FilterInfo(SelectInfo(0, 0, col_id), constant, comparison);
+}
+
+TEST(ScanCache, NormalizeFilters) {
+  FilterKey key(0, {makeFilter(1, 10, FilterInfo::Comparison::Greater),
+                    makeFilter(1, 20, FilterInfo::Comparison::Less),
+                    makeFilter(0, 5, FilterInfo::Comparison::Equal)});
+  ASSERT_FALSE(key.unsatisfiable());
+  ASSERT_EQ(key.ranges().size(), 2u);
+  ASSERT_EQ(key.ranges()[0], ColumnRange(0, 5, 5));
+  ASSERT_EQ(key.ranges()[1], ColumnRange(1, 11, 19));
+
+  // Filter order does not matter
+  FilterKey permuted(0, {makeFilter(0, 5, FilterInfo::Comparison::Equal),
+                         makeFilter(1, 20, FilterInfo::Comparison::Less),
+                         makeFilter(1, 10, FilterInfo::Comparison::Greater)});
+  ASSERT_EQ(key.str(), permuted.str());
+
+  FilterKey contradiction(0, {makeFilter(1, 50, FilterInfo::Comparison::Greater),
+                              makeFilter(1, 30, FilterInfo::Comparison::Less)});
+  ASSERT_TRUE(contradiction.unsatisfiable());
+}
+
+TEST(ScanCache, Implication) {
+  FilterKey narrow(0, {makeFilter(1, 10, FilterInfo::Comparison::Greater),
+                       makeFilter(2, 3, FilterInfo::Comparison::Equal)});
+  FilterKey wide(0, {makeFilter(1, 5, FilterInfo::Comparison::Greater)});
+  FilterKey other_rel(1, {makeFilter(1, 5, FilterInfo::Comparison::Greater)});
+
+  ASSERT_TRUE(narrow.implies(wide));
+  ASSERT_FALSE(wide.implies(narrow));
+  ASSERT_FALSE(narrow.implies(other_rel));
+}
+
+TEST(ScanCache, LookupAndEvict) {
+  FilterKey key1(0, {makeFilter(1, 5, FilterInfo::Comparison::Greater)});
+  FilterKey key2(0, {makeFilter(1, 7, FilterInfo::Comparison::Greater)});
+  FilterKey key3(1, {makeFilter(1, 5, FilterInfo::Comparison::Greater)});
+  auto ids = std::make_shared<const std::vector<uint32_t>>(
+      std::vector<uint32_t>{6, 7, 8, 9});
+
+  ScanCache cache;
+  bool exact;
+  ASSERT_EQ(cache.lookup(key1, exact), nullptr);
+  cache.insert(key1, ids);
+  ASSERT_EQ(cache.lookup(key1, exact), ids);
+  ASSERT_TRUE(exact);
+  // Narrower filters are answered from the wider cached selection
+  ASSERT_EQ(cache.lookup(key2, exact), ids);
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(cache.lookup(key3, exact), nullptr);
+  ASSERT_EQ(cache.hits(), 1u);
+  ASSERT_EQ(cache.partial_hits(), 1u);
+  ASSERT_EQ(cache.misses(), 2u);
+
+  // A budget of a single entry evicts the least recently used one
+  auto large_ids = std::make_shared<const std::vector<uint32_t>>(1000);
+  ScanCache small_cache(large_ids->size() * sizeof(uint32_t) * 3 / 2);
+  small_cache.insert(key1, large_ids);
+  small_cache.insert(key3, large_ids);
+  ASSERT_EQ(small_cache.size(), 1u);
+  ASSERT_EQ(small_cache.lookup(key1, exact), nullptr);
+  // The evicted entry no longer answers narrower filters either
+  ASSERT_EQ(small_cache.lookup(key2, exact), nullptr);
+  ASSERT_EQ(small_cache.lookup(key3, exact), large_ids);
+}
+
+TEST(ScanCache, FilterScanReusesSelection) {
+  Relation r = Utils::createRelation(100, 3);
+  ScanCache cache;
+  unsigned binding = 0;
+  SelectInfo filter_col(0, binding, 1);
+
+  {
+    std::vector<FilterInfo> filters{
+        FilterInfo(filter_col, 49, FilterInfo::Comparison::Greater)};
+    FilterScan scan(r, filters, &cache);
+    scan.require(SelectInfo(binding, 0));
+    scan.run();
+    ASSERT_EQ(scan.result_size(), 50u);
+    ASSERT_EQ(cache.misses(), 1u);
+  }
+  {
+    // Same filters: exact hit
+    std::vector<FilterInfo> filters{
+        FilterInfo(filter_col, 49, FilterInfo::Comparison::Greater)};
+    FilterScan scan(r, filters, &cache);
+    scan.require(SelectInfo(binding, 2));
+    scan.run();
+    ASSERT_EQ(scan.result_size(), 50u);
+    ASSERT_EQ(cache.hits(), 1u);
+    auto results = scan.getResults();
+    auto col = results[scan.resolve(SelectInfo(binding, 2))];
+    for (unsigned i = 0; i < scan.result_size(); ++i)
+      ASSERT_EQ(col[i], 50u + i);
+  }
+  {
+    // Additional filter: re-filter the cached selection
+    std::vector<FilterInfo> filters{
+        FilterInfo(filter_col, 49, FilterInfo::Comparison::Greater),
+        FilterInfo(SelectInfo(0, binding, 2), 60, FilterInfo::Comparison::Less)};
+    FilterScan scan(r, filters, &cache);
+    scan.require(SelectInfo(binding, 0));
+    scan.run();
+    ASSERT_EQ(scan.result_size(), 10u);
+    ASSERT_EQ(cache.partial_hits(), 1u);
+  }
+}
+
+}
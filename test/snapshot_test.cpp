@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "snapshot.h"
+#include "utils.h"
+
+namespace {
+
+// A relation with a key column, a skewed column and a sparse column
+Relation createSnapshotRelation(uint64_t size, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<uint64_t *> columns;
+  for (unsigned c = 0; c < 3; ++c)
+    columns.push_back(new uint64_t[size]);
+  for (uint64_t i = 0; i < size; ++i) {
+    columns[0][i] = i;
+    columns[1][i] = rng() % 10 ? 7 : rng() % 1000;
+    columns[2][i] = rng() % 1000000;
+  }
+  return Relation(size, std::move(columns));
+}
+
+void ASSERT_STATISTICS_EQ(const RelationStatistics &a, const RelationStatistics &b) {
+  ASSERT_EQ(a.size, b.size);
+  ASSERT_EQ(a.columns.size(), b.columns.size());
+  for (unsigned c = 0; c < a.columns.size(); ++c) {
+    auto &x = a.columns[c], &y = b.columns[c];
+    ASSERT_EQ(x.min, y.min);
+    ASSERT_EQ(x.max, y.max);
+    ASSERT_EQ(x.distinct, y.distinct);
+    ASSERT_EQ(x.unique, y.unique);
+    ASSERT_EQ(x.references, y.references);
+    ASSERT_EQ(x.histogram.get_interval_width(), y.histogram.get_interval_width());
+    ASSERT_EQ(x.histogram.get_interval_counts(), y.histogram.get_interval_counts());
+    ASSERT_EQ(x.values.words(), y.values.words());
+  }
+}
+
+TEST(Snapshot, ContentHash) {
+  auto r1 = createSnapshotRelation(1001, 1);
+  auto r2 = createSnapshotRelation(1001, 1);
+  ASSERT_EQ(contentHash(r1), contentHash(r2));
+  r2.columns()[2][1000] ^= 1;
+  ASSERT_NE(contentHash(r1), contentHash(r2));
+  ASSERT_NE(contentHash(r1), contentHash(createSnapshotRelation(1000, 1)));
+}
+
+TEST(Snapshot, StoreAndLoad) {
+  createSnapshotRelation(1001, 1).storeRelation("snapshot_r0");
+  createSnapshotRelation(500, 2).storeRelation("snapshot_r1");
+  std::remove("snapshot_r0" SNAPSHOT_SUFFIX);
+  std::remove("snapshot_r1" SNAPSHOT_SUFFIX);
+
+  // The first preparation writes the snapshots, the second one maps them
+  Joiner built, mapped;
+  for (auto joiner : {&built, &mapped}) {
+    joiner->setUseSnapshots(true);
+    joiner->addRelation("snapshot_r0");
+    joiner->addRelation("snapshot_r1");
+    joiner->buildStatistics();
+  }
+  ASSERT_EQ(built.snapshots_used(), 0u);
+  ASSERT_EQ(mapped.snapshots_used(), 2u);
+  for (unsigned r = 0; r < 2; ++r)
+    ASSERT_STATISTICS_EQ(built.statistics()[r], mapped.statistics()[r]);
+  // Foreign keys are detected again: column 1 of r1 refers to column 0 of r0
+  ASSERT_FALSE(mapped.statistics()[1].columns[1].references.empty());
+
+  QueryInfo query("0 1|0.0=1.1&0.2<500000|1.0");
+  ASSERT_DOUBLE_EQ(built.estimator().estimate(query, {0, 1}),
+                   mapped.estimator().estimate(query, {0, 1}));
+  ASSERT_EQ(built.join(query), mapped.join(query));
+
+  // A snapshot of other contents is not used
+  RelationStatistics statistics;
+  std::vector<ColumnIndex> indexes;
+  auto other = createSnapshotRelation(1001, 3);
+  ASSERT_FALSE(Snapshot::load("snapshot_r0" SNAPSHOT_SUFFIX, contentHash(other), other,
+                              statistics, indexes));
+  ASSERT_TRUE(indexes.empty());
+}
+
+}